@@ -0,0 +1,20 @@
+
+/*
+ * Auto generated Run-Time-Environment Configuration File
+ *      *** Do not modify ! ***
+ *
+ * Project: 'Trabalho_Final' 
+ * Target:  'Trabalho_Final_BareMetal' 
+ */
+
+#ifndef RTE_COMPONENTS_H
+#define RTE_COMPONENTS_H
+
+
+/*
+ * Define the Device Header File: 
+ */
+#define CMSIS_device_header "TM4C129.h"
+
+
+#endif /* RTE_COMPONENTS_H */
@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include "misc.h"
+
+#include "telemetry.h"
+#include "fleet.h"
+
+#define AGGREGATOR_CAPACITY 65536 // records per ring file by default
+#define AGGREGATOR_READ 4096      // bytes read from a line at a time
+#define AGGREGATOR_EVENTS 64      // epoll events taken at a time
+#define AGGREGATOR_POLL 100       // ms between two checks of the stop flag
+
+typedef struct {                  // controller line data type
+  const char *Path;
+  int Fd;
+  FleetHeaderObj *Ring;
+  TelemetryDecoderObj Decoder;
+  int Sequence;                   // last sequence seen, -1 before the first
+} LineObj;
+
+typedef struct {                  // worker thread data type
+  pthread_t Thread;
+  int Epoll;
+  int Lines;                      // lines still open
+} WorkerObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Usage(const char *program);
+static void Stop(int signal);
+static int OpenLine(LineObj *line);
+static FleetHeaderObj *OpenRing(const char *path, uint32_t capacity);
+static void *Worker(void *argument);
+static void Append(void *context, const uint8_t *record, int size);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static volatile sig_atomic_t stopping;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Collects the telemetry of many controllers, one serial line (or pty) each,
+// into one ring file per controller. The lines are spread over the worker
+// threads, each one waiting on its own lines with epoll, so ingestion grows
+// with the cores as controllers are added
+int main(int argc, char **argv)
+{
+  const char *directory = ".";
+  uint32_t capacity = AGGREGATOR_CAPACITY;
+  char path[4096];
+  struct epoll_event event;
+  struct sigaction action;
+  WorkerObj *workers;
+  LineObj *lines;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  uint64_t frames = 0;
+  uint64_t bad = 0;
+  int count;
+  int option;
+  int i;
+
+  while ((option = getopt(argc, argv, "d:t:c:")) != -1)
+  {
+    if (option == 'd')
+      directory = optarg;
+    else if (option == 't')
+      threads = atol(optarg);
+    else if (option == 'c')
+      capacity = (uint32_t)strtoul(optarg, NULL, 0);
+    else
+    {
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+  count = argc - optind;
+  if (count == 0 || threads < 1 || capacity == 0 || (capacity & (capacity - 1)))
+  {
+    Usage(argv[0]);
+    return 2;
+  }
+  if (threads > count)
+  {
+    threads = count;
+  }
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = Stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  lines = calloc((size_t)count, sizeof(LineObj));
+  workers = calloc((size_t)threads, sizeof(WorkerObj));
+  for (i = 0; i < threads; i++)
+  {
+    workers[i].Epoll = epoll_create1(0);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    lines[i].Path = argv[optind + i];
+    lines[i].Sequence = -1;
+    snprintf(path, sizeof(path), "%s/fleet-%03d.ring", directory, i);
+    if (OpenLine(&lines[i]) < 0 || (lines[i].Ring = OpenRing(path, capacity)) == NULL)
+    {
+      fprintf(stderr, "%s: %s\n", lines[i].Path, strerror(errno));
+      return 1;
+    }
+    event.events = EPOLLIN;
+    event.data.ptr = &lines[i];
+    epoll_ctl(workers[i % threads].Epoll, EPOLL_CTL_ADD, lines[i].Fd, &event);
+    workers[i % threads].Lines++;
+  }
+
+  for (i = 0; i < threads; i++)
+  {
+    pthread_create(&workers[i].Thread, NULL, Worker, &workers[i]);
+  }
+  for (i = 0; i < threads; i++)
+  {
+    pthread_join(workers[i].Thread, NULL);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    frames += lines[i].Decoder.Frames;
+    bad += lines[i].Decoder.BadFrames;
+  }
+  fprintf(stderr, "%d lines, %ld threads: %llu records, %llu bad frames\n", count, threads,
+          (unsigned long long)frames, (unsigned long long)bad);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Aggregator Functions
+ *---------------------------------------------------------------------------*/
+
+static void Usage(const char *program)
+{
+  fprintf(stderr, "usage: %s [-d directory] [-t threads] [-c records] line...\n"
+                  "  one ring file fleet-NNN.ring per line, in the order given\n", program);
+}
+
+static void Stop(int signal)
+{
+  stopping = 1;
+}
+
+// Raw 8N1 at the UART1 rate when the line is a terminal
+static int OpenLine(LineObj *line)
+{
+  struct termios mode;
+
+  line->Fd = open(line->Path, O_RDONLY | O_NONBLOCK | O_NOCTTY);
+  if (line->Fd < 0)
+  {
+    return -1;
+  }
+  if (isatty(line->Fd) && tcgetattr(line->Fd, &mode) == 0)
+  {
+    cfmakeraw(&mode);
+    cfsetspeed(&mode, B115200);
+    tcsetattr(line->Fd, TCSANOW, &mode);
+  }
+  return 0;
+}
+
+// A new ring each run, the readers map it by name
+static FleetHeaderObj *OpenRing(const char *path, uint32_t capacity)
+{
+  FleetHeaderObj *header;
+  size_t size = FLEET_FILE_SIZE(capacity);
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)size) < 0)
+  {
+    close(fd);
+    return NULL;
+  }
+  header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (header == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  header->Version = FLEET_VERSION;
+  header->RecordSize = sizeof(FleetRecordObj);
+  header->Capacity = capacity;
+  atomic_store_explicit(&header->Head, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  header->Magic = FLEET_MAGIC;
+  return header;
+}
+
+// Until stopped or every line of this worker is closed by its far end
+static void *Worker(void *argument)
+{
+  WorkerObj *worker = argument;
+  struct epoll_event events[AGGREGATOR_EVENTS];
+  uint8_t bytes[AGGREGATOR_READ];
+  LineObj *line;
+  ssize_t size;
+  int ready;
+  int i;
+
+  while (!stopping && worker->Lines > 0)
+  {
+    ready = epoll_wait(worker->Epoll, events, AGGREGATOR_EVENTS, AGGREGATOR_POLL);
+    for (i = 0; i < ready; i++)
+    {
+      line = events[i].data.ptr;
+      while ((size = read(line->Fd, bytes, sizeof(bytes))) > 0)
+      {
+        line->Ring->Bytes += (uint64_t)size;
+        TelemetryPush(&line->Decoder, bytes, (int)size, Append, line);
+      }
+      if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR))
+      {
+        // EIO once the far end of a pty is closed
+        epoll_ctl(worker->Epoll, EPOLL_CTL_DEL, line->Fd, NULL);
+        close(line->Fd);
+        worker->Lines--;
+      }
+      line->Ring->BadFrames = line->Decoder.BadFrames;
+    }
+  }
+  return NULL;
+}
+
+// One good record into the ring of its line
+static void Append(void *context, const uint8_t *record, int size)
+{
+  LineObj *line = context;
+  FleetHeaderObj *ring = line->Ring;
+  uint64_t head = atomic_load_explicit(&ring->Head, memory_order_relaxed);
+  FleetRecordObj *slot = &FLEET_RECORDS(ring)[head & (ring->Capacity - 1)];
+  struct timespec now;
+
+  if (line->Sequence >= 0)
+  {
+    ring->Gaps += (uint8_t)(record[0] - line->Sequence - 1);
+  }
+  line->Sequence = record[0];
+  if (size >= 3 && record[1] == TELEMETRY_ANNOUNCE)
+  {
+    ring->Controller = record[2];
+  }
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  slot->Time = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  slot->Size = (uint8_t)size;
+  memcpy(slot->Payload, record, (size_t)size);
+  atomic_store_explicit(&ring->Head, head + 1, memory_order_release);
+}
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "inc/hw_memmap.h"
+
+#include "target.h"
+#include "controller.h"
+
+#define BENCH_TIME 200000000ULL // ns each benchmark runs for at least
+#define BENCH_BATCH 1000        // operations between two clock reads
+#define BENCH_NAME 32
+#define BENCH_QUEUE 16          // depth of the stand-ins for the RTX queues
+#define BENCH_TOLERANCE 25.0    // % slower than the baseline that fails -b
+
+typedef struct {                // benchmark data type
+  const char *Name;
+  void (*Setup)(void);
+  void (*Run)(void);
+} BenchObj;
+
+typedef struct {                // result data type
+  char Name[BENCH_NAME];
+  double Ns;
+} ResultObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static uint64_t Now(void);
+static double Measure(const BenchObj *bench);
+static int LoadBaseline(const char *path, ResultObj *results, int max);
+static void Usage(const char *program);
+
+static void SetupIdle(void);
+static void SetupBusy(void);
+static void SetupSweep(void);
+static void DrainMain(void);
+static void RunFloorReport(void);
+static void RunHallCall(void);
+static void RunFloorString(void);
+static void RunCarCall(void);
+static void RunFloorResponse(void);
+static void RunArrival(void);
+static void RunDoorFrame(void);
+static void RunReoptimize(void);
+static void RunDispatch(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static ElevatorObj car;
+static ElevatorObj start;
+static volatile char sink;
+
+static const BenchObj benches[] = {
+  {"isr_floor_report", SetupIdle, RunFloorReport},     // "c5\r" through UART0
+  {"isr_hall_call", SetupIdle, RunHallCall},           // "cE05s\r" through UART0
+  {"floor_string", SetupIdle, RunFloorString},         // both digits of a report
+  {"central_command", SetupIdle, RunCarCall},          // car call on an idle car
+  {"central_response", SetupBusy, RunFloorResponse},   // floor report while busy
+  {"central_arrival", SetupBusy, RunArrival},          // stop at the target
+  {"encode_door", SetupIdle, RunDoorFrame},            // one frame to the null UART
+  {"reoptimize", SetupSweep, RunReoptimize},           // both plans of a sweep
+  {"dispatch", SetupBusy, RunDispatch},                // report from the FIFO to the decision
+};
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// ns/op of the controller hot paths, optionally saved as a baseline (-s) or
+// compared against one (-b). The exit status is 1 when a benchmark is more
+// than the tolerance (-t, in %) slower than its baseline. Built once per
+// variant of main.c, USE_RTOS 1 and 0
+int main(int argc, char **argv)
+{
+  ResultObj baseline[sizeof(benches) / sizeof(benches[0])];
+  const char *savePath = NULL;
+  const char *basePath = NULL;
+  double tolerance = BENCH_TOLERANCE;
+  double change;
+  int slower = 0;
+  FILE *save = NULL;
+  int baselineCount = 0;
+  double ns;
+  size_t i;
+  int j;
+  int option;
+
+  while ((option = getopt(argc, argv, "s:b:t:")) != -1)
+  {
+    if (option == 's')
+      savePath = optarg;
+    else if (option == 'b')
+      basePath = optarg;
+    else if (option == 't')
+      tolerance = atof(optarg);
+    else
+    {
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (basePath)
+  {
+    baselineCount = LoadBaseline(basePath, baseline, sizeof(baseline) / sizeof(baseline[0]));
+    if (baselineCount < 0)
+    {
+      fprintf(stderr, "cannot read baseline %s\n", basePath);
+      return 1;
+    }
+  }
+  if (savePath && (save = fopen(savePath, "w")) == NULL)
+  {
+    fprintf(stderr, "cannot write baseline %s\n", savePath);
+    return 1;
+  }
+
+#if USE_RTOS
+  qidMain = osMessageQueueNew(BENCH_QUEUE, sizeof(MsgObj), NULL);
+  qidCentralResponses = osMessageQueueNew(BENCH_QUEUE, sizeof(MsgObj), NULL);
+#endif
+  SetupController();
+
+  printf("%-20s %12s %14s", "benchmark", "ns/op", "ops/s");
+  printf(basePath ? " %12s %8s\n" : "\n", "baseline", "change");
+  for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+  {
+    ns = Measure(&benches[i]);
+    printf("%-20s %12.1f %14.0f", benches[i].Name, ns, 1e9 / ns);
+    for (j = 0; j < baselineCount; j++)
+    {
+      if (strcmp(baseline[j].Name, benches[i].Name) == 0)
+      {
+        change = 100.0 * (ns - baseline[j].Ns) / baseline[j].Ns;
+        printf(" %12.1f %+7.1f%%%s", baseline[j].Ns, change, change > tolerance ? " SLOWER" : "");
+        slower += change > tolerance;
+      }
+    }
+    printf("\n");
+    if (save)
+    {
+      fprintf(save, "%s %.1f\n", benches[i].Name, ns);
+    }
+  }
+
+  if (save)
+  {
+    fclose(save);
+  }
+  if (slower)
+  {
+    printf("%d benchmarks more than %.0f%% slower than the baseline\n", slower, tolerance);
+    return 1;
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Bench Functions
+ *---------------------------------------------------------------------------*/
+
+static uint64_t Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Batches of BENCH_BATCH operations until BENCH_TIME has elapsed, the best
+// batch is kept so a preemption does not count
+static double Measure(const BenchObj *bench)
+{
+  uint64_t begin = Now();
+  uint64_t batch;
+  uint64_t best = UINT64_MAX;
+  uint64_t elapsed;
+  int i;
+
+  do
+  {
+    bench->Setup();
+    batch = Now();
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+      bench->Run();
+    }
+    elapsed = Now() - batch;
+    if (elapsed < best)
+    {
+      best = elapsed;
+    }
+  } while (Now() - begin < BENCH_TIME);
+
+  return (double)best / BENCH_BATCH;
+}
+
+// Lines of "<name> <ns/op>" as written by -s
+static int LoadBaseline(const char *path, ResultObj *results, int max)
+{
+  FILE *file = fopen(path, "r");
+  int count = 0;
+
+  if (!file)
+  {
+    return -1;
+  }
+  while (count < max && fscanf(file, "%31s %lf", results[count].Name, &results[count].Ns) == 2)
+  {
+    count++;
+  }
+  fclose(file);
+  return count;
+}
+
+static void Usage(const char *program)
+{
+  fprintf(stderr, "usage: %s [-s baseline] [-b baseline [-t percent]]\n", program);
+}
+
+/*----------------------------------------------------------------------------
+ *      Benchmarks
+ *---------------------------------------------------------------------------*/
+
+static void SetupIdle()
+{
+  ElevatorObj idle = {CENTRAL_ELEVATOR, READY, FLOOR_5, FLOOR_5};
+
+  start = idle;
+  car = start;
+}
+
+static void SetupBusy()
+{
+  ElevatorObj busy = {CENTRAL_ELEVATOR, BUSY, FLOOR_4, FLOOR_5};
+
+  start = busy;
+  car = start;
+}
+
+// Destination mode, going up from 5 with stops on both sides
+static void SetupSweep()
+{
+  ElevatorObj sweep = {CENTRAL_ELEVATOR, BUSY, FLOOR_5, FLOOR_9, UP, CLOSED, DESTINATION_MODE,
+                       FLOOR_BIT(FLOOR_1) | FLOOR_BIT(FLOOR_3) | FLOOR_BIT(FLOOR_9) | FLOOR_BIT(FLOOR_12), {0}};
+
+  start = sweep;
+  car = start;
+}
+
+// Frames the ISR queued are dropped, only the receive path is timed
+static void DrainMain()
+{
+#if USE_RTOS
+  osMessageQueueReset(qidMain);
+#else
+  ringMain.Tail = ringMain.Head;
+#endif
+}
+
+static void RunFloorReport()
+{
+  HostReceive(UART0_BASE, "c5\r", 3);
+  DrainMain();
+}
+
+static void RunHallCall()
+{
+  HostReceive(UART0_BASE, "cE05s\r", 6);
+  DrainMain();
+}
+
+static void RunFloorString()
+{
+  sink = GetFloorCharFromFloorNumberString('5', '1');
+  sink = GetFloorCharFromFloorNumberString('9', '0');
+}
+
+static void RunCarCall()
+{
+  MsgObj msg = {{CENTRAL_ELEVATOR, 'I', FLOOR_9}, 3};
+
+  car = start;
+  CentralCommand(&car, &msg);
+}
+
+static void RunFloorResponse()
+{
+  MsgObj msg = {{CENTRAL_ELEVATOR, '5'}, 2};
+
+  car = start;
+  CentralResponse(&car, &msg);
+}
+
+static void RunArrival()
+{
+  car = start;
+  car.ActualFloor = car.TargetFloor;
+  CentralArrival(&car);
+}
+
+static void RunDoorFrame()
+{
+  ChangeDoorStatus(CENTRAL_ELEVATOR, CLOSED);
+}
+
+static void RunReoptimize()
+{
+  car = start;
+  Reoptimize(&car);
+}
+
+// The hops of ThreadMain and ThreadCentral, or of the event loop. The RTX
+// context switches between the two threads are not part of the host figure
+static void RunDispatch()
+{
+  MsgObj msg;
+
+  car = start;
+  HostReceive(UART0_BASE, "c5\r", 3);
+#if USE_RTOS
+  osMessageQueueGet(qidMain, &msg, NULL, 0U);
+  osMessageQueuePut(qidCentralResponses, &msg, 0U, 0U);
+  osMessageQueueGet(qidCentralResponses, &msg, NULL, 0U);
+#else
+  RingGet(&ringMain, &msg);
+  RingPut(&ringCentralResponses, &msg);
+  RingGet(&ringCentralResponses, &msg);
+#endif
+  CentralResponse(&car, &msg);
+}
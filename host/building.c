@@ -0,0 +1,702 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "misc.h"
+
+#include "building.h"
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static double Uniform(uint64_t *random);
+static void LinkPut(BuildingObj *building, LinkObj *link, const char *frame, int size);
+static void Say(BuildingObj *building, int car, const char *frame, int size);
+static void Apply(BuildingObj *building, const char *frame, int size);
+static void Move(BuildingObj *building, int car);
+static void Door(BuildingObj *building, int car);
+static void Exchange(BuildingObj *building, int car, int floor);
+static void Arrive(BuildingObj *building, int car, int origin, int destination, bool evacuee);
+static void PressHall(BuildingObj *building, PassengerObj *passenger);
+static void PressCar(BuildingObj *building, int car, int floor);
+static void PressAgain(BuildingObj *building);
+static void Evacuate(BuildingObj *building);
+static void Fail(BuildingObj *building, bool failed);
+static int FloorAt(const CarModelObj *model);
+static bool AtFloor(const CarModelObj *model);
+
+/*----------------------------------------------------------------------------
+ *      Building Functions
+ *---------------------------------------------------------------------------*/
+
+// Course simulator figures: 1.5 s a floor, 2 s a door, a light load
+void BuildingDefaults(BuildingConfigObj *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->Cars = 1;
+  config->FloorTime = 1500;
+  config->DoorTime = 2000;
+  config->Latency = 5;
+  config->Arrivals = 1.0;
+  config->Lobby = 0.5;
+  config->Capacity = 8;
+  config->Occupants = 10;
+  config->Seed = 1;
+}
+
+// Cars at the exit floor with the door open, as the controller assumes
+void BuildingInit(BuildingObj *building, const BuildingConfigObj *config)
+{
+  int i;
+
+  memset(building, 0, sizeof(*building));
+  building->Config = *config;
+  if (building->Config.Cars < 1 || building->Config.Cars > BUILDING_CARS)
+  {
+    building->Config.Cars = 1;
+  }
+  building->Random = ((uint64_t)config->Seed << 1 | 1) * 0x9E3779B97F4A7C15ULL;
+  building->Obstructions = building->Random ^ 0xD1B54A32D192ED03ULL;
+  for (i = 0; i < BUILDING_CARS; i++)
+  {
+    building->Cars[i].Door = OPEN;
+  }
+  if (config->Arrivals > 0)
+  {
+    building->NextArrival = (uint32_t)(-log(1.0 - Uniform(&building->Random)) * 60000.0 / config->Arrivals);
+  }
+}
+
+// A frame from the controller, without its END_COMMAND; acted on once the
+// link latency has passed
+void BuildingCommand(BuildingObj *building, const char *frame, int size)
+{
+  if (size < 2 || size > BUILDING_FRAME)
+  {
+    return;
+  }
+  LinkPut(building, &building->FromController, frame, size);
+}
+
+// Up to now, one ms at a time
+void BuildingStep(BuildingObj *building, uint32_t now)
+{
+  const BuildingConfigObj *config = &building->Config;
+  LinkObj *link;
+  LinkFrameObj *frame;
+  int car;
+
+  while ((int32_t)(now - building->Now) > 0)
+  {
+    building->Now++;
+
+    if (config->FailAt && building->Now == config->FailAt)
+    {
+      Fail(building, true);
+    }
+    if (config->FailAt && building->Now == config->FailAt + config->FailFor)
+    {
+      Fail(building, false);
+    }
+    if (config->EvacuateAt && building->Now == config->EvacuateAt)
+    {
+      Evacuate(building);
+    }
+    if (building->Now % 1000 == 0 || config->Mash)
+    {
+      PressAgain(building);
+    }
+
+    link = &building->FromController;
+    while (link->Count && (int32_t)(building->Now - link->Frames[link->Head].Due) >= 0)
+    {
+      frame = &link->Frames[link->Head];
+      link->Head = (link->Head + 1) % BUILDING_FRAMES;
+      link->Count--;
+      Apply(building, frame->Frame, frame->Size);
+    }
+
+    for (car = 0; car < BUILDING_CARS; car++)
+    {
+      Move(building, car);
+      Door(building, car);
+    }
+
+    if (!building->Evacuating && config->Arrivals > 0 && building->Now >= building->NextArrival)
+    {
+      int origin = (Uniform(&building->Random) < config->Lobby) ? 0 : 1 + (int)(Uniform(&building->Random) * (FLOORS - 1));
+      int destination;
+
+      if (origin != 0 && Uniform(&building->Random) < 0.5)
+      {
+        destination = 0;
+      }
+      else
+      {
+        destination = (origin + 1 + (int)(Uniform(&building->Random) * (FLOORS - 1))) % FLOORS;
+      }
+      Arrive(building, (int)(Uniform(&building->Random) * config->Cars), origin, destination, false);
+      building->NextArrival = building->Now + 1
+                              + (uint32_t)(-log(1.0 - Uniform(&building->Random)) * 60000.0 / config->Arrivals);
+    }
+
+    link = &building->ToController;
+    while (link->Count && (int32_t)(building->Now - link->Frames[link->Head].Due) >= 0)
+    {
+      frame = &link->Frames[link->Head];
+      link->Head = (link->Head + 1) % BUILDING_FRAMES;
+      link->Count--;
+      if (building->Send)
+      {
+        building->Send(building->Context, frame->Frame, frame->Size);
+      }
+    }
+  }
+}
+
+// A passenger placed by the owner, calling at once
+void BuildingArrive(BuildingObj *building, int car, int origin, int destination)
+{
+  Arrive(building, car, origin, destination, false);
+}
+
+// Nobody waiting or riding, nothing on the link and every car still
+bool BuildingIdle(const BuildingObj *building)
+{
+  int i;
+
+  if (building->ToController.Count || building->FromController.Count)
+  {
+    return false;
+  }
+  for (i = 0; i < building->PassengerCount; i++)
+  {
+    if (building->Passengers[i].State != PASSENGER_FREE)
+    {
+      return false;
+    }
+  }
+  for (i = 0; i < BUILDING_CARS; i++)
+  {
+    if (building->Cars[i].Motion || building->Cars[i].DoorTarget)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Count who is left at the end of a run
+void BuildingFinish(BuildingObj *building)
+{
+  int i;
+
+  building->Stats.Unserved = 0;
+  for (i = 0; i < building->PassengerCount; i++)
+  {
+    if (building->Passengers[i].State != PASSENGER_FREE)
+    {
+      building->Stats.Unserved++;
+    }
+  }
+}
+
+// Wait at or under which the share of the passengers served boarded, to the
+// bucket, the longest one when it falls in the open bucket
+uint32_t BuildingPercentile(const BuildingStatsObj *stats, double share)
+{
+  uint32_t count = 0;
+  uint32_t wanted = (uint32_t)ceil(share * stats->Served);
+  int i;
+
+  for (i = 0; i < BUILDING_BUCKETS - 1; i++)
+  {
+    count += stats->Waits[i];
+    if (count >= wanted && count)
+    {
+      return (uint32_t)(i + 1) * BUILDING_BUCKET;
+    }
+  }
+  return stats->WaitMax;
+}
+
+// kJ the cars drew, from the floors travelled and the starts
+double BuildingEnergy(const BuildingObj *building)
+{
+  double energy = 0;
+  int i;
+
+  for (i = 0; i < BUILDING_CARS; i++)
+  {
+    energy += (double)building->Cars[i].Travelled / BUILDING_FLOOR_HEIGHT * BUILDING_FLOOR_ENERGY
+              + building->Cars[i].Starts * BUILDING_START_ENERGY;
+  }
+  return energy;
+}
+
+// What the passengers waited and what car 'c' spent to carry them
+void BuildingReport(const BuildingObj *building, FILE *file)
+{
+  const BuildingStatsObj *stats = &building->Stats;
+  const CarModelObj *car = &building->Cars[0];
+  double served = stats->Served ? stats->Served : 1;
+
+  fprintf(file, "passengers  %u served, %u unserved, %u refused\n", stats->Served, stats->Unserved, stats->Refused);
+  fprintf(file, "wait        avg %.1f s, p50 %u s, p95 %u s, max %.1f s\n", stats->WaitTotal / served / 1000.0,
+          BuildingPercentile(stats, 0.50) / 1000, BuildingPercentile(stats, 0.95) / 1000, stats->WaitMax / 1000.0);
+  fprintf(file, "trip        avg %.1f s\n", stats->TripTotal / served / 1000.0);
+  fprintf(file, "car         %.1f floors, %u starts, %u door cycles, %u reopened\n",
+          (double)car->Travelled / BUILDING_FLOOR_HEIGHT, car->Starts, car->DoorCycles, car->Reopened);
+  fprintf(file, "energy      %.0f kJ, %.1f kJ per passenger\n", BuildingEnergy(building),
+          BuildingEnergy(building) / served);
+  fprintf(file, "link        %u frames dropped\n", building->ToController.Dropped + building->FromController.Dropped);
+}
+
+/*----------------------------------------------------------------------------
+ *      Model Functions
+ *---------------------------------------------------------------------------*/
+
+// xorshift64*, the same sequence for the same seed on every host
+static double Uniform(uint64_t *random)
+{
+  *random ^= *random >> 12;
+  *random ^= *random << 25;
+  *random ^= *random >> 27;
+  return (double)((*random * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+static void LinkPut(BuildingObj *building, LinkObj *link, const char *frame, int size)
+{
+  LinkFrameObj *slot;
+
+  if (link->Count == BUILDING_FRAMES)
+  {
+    link->Dropped++;
+    return;
+  }
+  slot = &link->Frames[(link->Head + link->Count) % BUILDING_FRAMES];
+  slot->Due = building->Now + building->Config.Latency;
+  slot->Size = size;
+  memcpy(slot->Frame, frame, (size_t)size);
+  link->Count++;
+}
+
+// Everything a car says goes through here: nothing while its link is down
+static void Say(BuildingObj *building, int car, const char *frame, int size)
+{
+  if (car == 0 && building->Failed)
+  {
+    return;
+  }
+  LinkPut(building, &building->ToController, frame, size);
+}
+
+static void Apply(BuildingObj *building, const char *frame, int size)
+{
+  int car = frame[0] - CENTRAL_ELEVATOR;
+  CarModelObj *model;
+  int floor;
+
+  if (car < 0 || car >= BUILDING_CARS || (car == 0 && building->Failed))
+  {
+    return;
+  }
+  model = &building->Cars[car];
+
+  switch (frame[1])
+  {
+  case INIT_ELEVATOR:
+    model->Resets++;
+    model->Homing = model->Position > 0;
+    model->Motion = model->Homing ? -1 : 0;
+    model->Held = 0;
+    model->Lights = 0;
+    break;
+  case UP:
+  case DOWN:
+    // The controller already counts the car at the exit floor
+    if (model->Homing)
+    {
+      model->Held = frame[1];
+      break;
+    }
+    if (!model->Motion)
+    {
+      model->Starts++;
+    }
+    model->Motion = (frame[1] == UP) ? 1 : -1;
+    model->Homing = false;
+    break;
+  case STOP:
+    // Homing runs to the end whatever the controller says
+    if (model->Homing)
+    {
+      break;
+    }
+    // Re-levels at a floor it has just passed, the report came from there,
+    // otherwise it stays where it is, between floors
+    model->Motion = 0;
+    if (abs(model->Position - FloorAt(model) * BUILDING_FLOOR_HEIGHT) <= BUILDING_LEVEL)
+    {
+      model->Position = FloorAt(model) * BUILDING_FLOOR_HEIGHT;
+    }
+    break;
+  case OPEN:
+  case CLOSED:
+    // A door on the move finishes first, each command gets its own ack
+    if (!model->DoorTarget)
+    {
+      model->DoorTarget = frame[1];
+      model->DoorDone = building->Now + building->Config.DoorTime;
+    }
+    else if (model->DoorQueued < BUILDING_DOORS)
+    {
+      model->DoorQueue[model->DoorQueued++] = frame[1];
+    }
+    break;
+  case ON:
+  case OFF:
+    floor = (size >= 3) ? frame[2] - FLOOR_0 : -1;
+    if (floor >= 0 && floor < FLOORS)
+    {
+      if (frame[1] == ON)
+        model->Lights |= (uint16_t)(1U << floor);
+      else
+        model->Lights &= (uint16_t)~(1U << floor);
+    }
+    break;
+  }
+}
+
+// Travel at FloorTime a floor, reporting each floor reached. The shaft ends
+// stop the car whatever it was told
+static void Move(BuildingObj *building, int car)
+{
+  CarModelObj *model = &building->Cars[car];
+  int32_t speed = BUILDING_FLOOR_HEIGHT / (int32_t)building->Config.FloorTime;
+  int32_t before = model->Position;
+  char frame[BUILDING_FRAME];
+  int floor;
+  int size;
+
+  if (!model->Motion || (car == 0 && building->Failed))
+  {
+    return;
+  }
+
+  model->Position += model->Motion * speed;
+  if (model->Position <= 0)
+  {
+    model->Position = 0;
+    model->Motion = 0;
+  }
+  else if (model->Position >= (FLOORS - 1) * BUILDING_FLOOR_HEIGHT)
+  {
+    model->Position = (FLOORS - 1) * BUILDING_FLOOR_HEIGHT;
+    model->Motion = 0;
+  }
+  model->Travelled += (uint64_t)(before > model->Position ? before - model->Position : model->Position - before);
+
+  // Home without reports, then off on the move the controller asked for
+  if (model->Homing)
+  {
+    if (!model->Position)
+    {
+      model->Motion = (model->Held == UP) ? 1 : 0;
+      model->Starts += model->Held == UP;
+      model->Homing = false;
+      model->Held = 0;
+    }
+    return;
+  }
+
+  // A floor level crossed or reached on the way
+  if (model->Position > before && model->Position / BUILDING_FLOOR_HEIGHT > before / BUILDING_FLOOR_HEIGHT)
+  {
+    floor = model->Position / BUILDING_FLOOR_HEIGHT;
+  }
+  else if (model->Position < before
+           && (model->Position + BUILDING_FLOOR_HEIGHT - 1) / BUILDING_FLOOR_HEIGHT
+              < (before + BUILDING_FLOOR_HEIGHT - 1) / BUILDING_FLOOR_HEIGHT)
+  {
+    floor = (model->Position + BUILDING_FLOOR_HEIGHT - 1) / BUILDING_FLOOR_HEIGHT;
+  }
+  else
+  {
+    return;
+  }
+  size = snprintf(frame, sizeof(frame), "%c%d", CENTRAL_ELEVATOR + car, floor);
+  Say(building, car, frame, size);
+}
+
+// A close can be undone by an obstruction, acked 'A' as the simulator does
+static void Door(BuildingObj *building, int car)
+{
+  CarModelObj *model = &building->Cars[car];
+  char frame[2] = {(char)(CENTRAL_ELEVATOR + car), 0};
+  int floor = FloorAt(model);
+  int i;
+
+  if (!model->DoorTarget || (int32_t)(building->Now - model->DoorDone) < 0 || (car == 0 && building->Failed))
+  {
+    return;
+  }
+
+  if (model->DoorTarget == CLOSED && Uniform(&building->Obstructions) < building->Config.Reopen)
+  {
+    model->Reopened++;
+    model->Door = OPEN;
+  }
+  else
+  {
+    model->Door = model->DoorTarget;
+  }
+  model->DoorTarget = 0;
+  frame[1] = (model->Door == OPEN) ? OPEN_ACK : CLOSED_ACK;
+  Say(building, car, frame, 2);
+  if (model->DoorQueued)
+  {
+    model->DoorTarget = model->DoorQueue[0];
+    model->DoorDone = building->Now + building->Config.DoorTime;
+    model->DoorQueued--;
+    memmove(model->DoorQueue, model->DoorQueue + 1, (size_t)model->DoorQueued);
+  }
+
+  if (!AtFloor(model))
+  {
+    return;
+  }
+  if (model->Door == OPEN)
+  {
+    model->DoorCycles++;
+    Exchange(building, car, floor);
+  }
+  else
+  {
+    // Left behind by a full car: the button again
+    for (i = 0; i < building->PassengerCount; i++)
+    {
+      PassengerObj *passenger = &building->Passengers[i];
+
+      if (passenger->State == PASSENGER_WAITING && passenger->Car == car && passenger->Origin == floor)
+      {
+        PressHall(building, passenger);
+      }
+    }
+  }
+}
+
+// Riders for this floor out, then waiting passengers in while there is room,
+// each pressing the button of their floor
+static void Exchange(BuildingObj *building, int car, int floor)
+{
+  CarModelObj *model = &building->Cars[car];
+  BuildingStatsObj *stats = &building->Stats;
+  uint16_t pressed = 0;
+  uint32_t wait;
+  int i;
+
+  for (i = 0; i < building->PassengerCount; i++)
+  {
+    PassengerObj *passenger = &building->Passengers[i];
+
+    if (passenger->State != PASSENGER_RIDING || passenger->Car != car || passenger->Destination != floor)
+    {
+      continue;
+    }
+    passenger->State = PASSENGER_FREE;
+    model->Load--;
+    stats->Served++;
+    stats->TripTotal += building->Now - passenger->Arrival;
+    if (passenger->Evacuee && --stats->EvacuationLeft == 0)
+    {
+      stats->EvacuationTime = building->Now - building->Config.EvacuateAt;
+    }
+  }
+
+  for (i = 0; i < building->PassengerCount && model->Load < building->Config.Capacity; i++)
+  {
+    PassengerObj *passenger = &building->Passengers[i];
+
+    if (passenger->State != PASSENGER_WAITING || passenger->Car != car || passenger->Origin != floor)
+    {
+      continue;
+    }
+    passenger->State = PASSENGER_RIDING;
+    passenger->Board = building->Now;
+    passenger->Pressed = building->Now;
+    model->Load++;
+
+    wait = building->Now - passenger->Arrival;
+    stats->WaitTotal += wait;
+    stats->Waits[(wait / BUILDING_BUCKET < BUILDING_BUCKETS - 1) ? wait / BUILDING_BUCKET : BUILDING_BUCKETS - 1]++;
+    if (wait > stats->WaitMax)
+    {
+      stats->WaitMax = wait;
+    }
+    if (!(pressed & (1U << passenger->Destination)))
+    {
+      pressed |= (uint16_t)(1U << passenger->Destination);
+      PressCar(building, car, passenger->Destination);
+    }
+  }
+}
+
+// A new passenger at the hall, or straight in when the car stands open there
+static void Arrive(BuildingObj *building, int car, int origin, int destination, bool evacuee)
+{
+  CarModelObj *model = &building->Cars[car];
+  PassengerObj *passenger = NULL;
+  int i;
+
+  for (i = 0; i < building->PassengerCount; i++)
+  {
+    if (building->Passengers[i].State == PASSENGER_FREE)
+    {
+      passenger = &building->Passengers[i];
+      break;
+    }
+  }
+  if (!passenger && building->PassengerCount < BUILDING_PASSENGERS)
+  {
+    passenger = &building->Passengers[building->PassengerCount++];
+  }
+  if (!passenger)
+  {
+    building->Stats.Refused++;
+    return;
+  }
+
+  passenger->Car = (uint8_t)car;
+  passenger->Origin = (uint8_t)origin;
+  passenger->Destination = (uint8_t)destination;
+  passenger->State = PASSENGER_WAITING;
+  passenger->Evacuee = evacuee;
+  passenger->Arrival = building->Now;
+
+  if (!model->Motion && !model->DoorTarget && model->Door == OPEN && AtFloor(model) && FloorAt(model) == origin
+      && model->Load < building->Config.Capacity)
+  {
+    Exchange(building, car, origin);
+  }
+  else
+  {
+    PressHall(building, passenger);
+  }
+}
+
+static void PressHall(BuildingObj *building, PassengerObj *passenger)
+{
+  char frame[BUILDING_FRAME];
+  int size = snprintf(frame, sizeof(frame), "%cE%02d%c", CENTRAL_ELEVATOR + passenger->Car, passenger->Origin,
+                      (passenger->Destination > passenger->Origin) ? UP : DOWN);
+
+  passenger->Pressed = building->Now;
+  Say(building, passenger->Car, frame, size);
+}
+
+static void PressCar(BuildingObj *building, int car, int floor)
+{
+  char frame[3] = {(char)(CENTRAL_ELEVATOR + car), INTERNAL_BUTTON, (char)(FLOOR_0 + floor)};
+
+  Say(building, car, frame, 3);
+}
+
+// A button the controller has not lit, or has put out without serving it,
+// is pressed again once the passenger tires of waiting. With Mash set every
+// passenger keeps pressing at that pace, lit or not
+static void PressAgain(BuildingObj *building)
+{
+  uint16_t pressed[BUILDING_CARS] = {0};
+  uint32_t repress = building->Config.Mash ? building->Config.Mash : BUILDING_REPRESS;
+  int i;
+
+  for (i = 0; i < building->PassengerCount; i++)
+  {
+    PassengerObj *passenger = &building->Passengers[i];
+    CarModelObj *model = &building->Cars[passenger->Car];
+    int floor = (passenger->State == PASSENGER_RIDING) ? passenger->Destination : passenger->Origin;
+
+    if (passenger->State == PASSENGER_FREE || (!building->Config.Mash && (model->Lights & (1U << floor)))
+        || building->Now - passenger->Pressed < repress
+        || (!model->Motion && AtFloor(model) && FloorAt(model) == floor))
+    {
+      continue;
+    }
+    if (passenger->State == PASSENGER_WAITING)
+    {
+      PressHall(building, passenger);
+    }
+    else
+    {
+      passenger->Pressed = building->Now;
+      if (!(pressed[passenger->Car] & (1U << floor)))
+      {
+        pressed[passenger->Car] |= (uint16_t)(1U << floor);
+        PressCar(building, passenger->Car, floor);
+      }
+    }
+  }
+}
+
+// The fire panel, then Occupants people on every floor above the exit all
+// heading out, spread over the cars
+static void Evacuate(BuildingObj *building)
+{
+  char frame[2] = {0, EVACUATE};
+  int car;
+  int floor;
+  int i;
+
+  building->Evacuating = true;
+  for (car = 0; car < building->Config.Cars; car++)
+  {
+    frame[0] = (char)(CENTRAL_ELEVATOR + car);
+    Say(building, car, frame, 2);
+  }
+  for (floor = 1; floor < FLOORS; floor++)
+  {
+    for (i = 0; i < building->Config.Occupants; i++)
+    {
+      building->Stats.EvacuationLeft++;
+      Arrive(building, (floor + i) % building->Config.Cars, floor, EXIT_FLOOR - FLOOR_0, true);
+    }
+  }
+  if (!building->Stats.EvacuationLeft)
+  {
+    building->Stats.EvacuationTime = 1;
+  }
+}
+
+// Car 'c' loses its link and drive and later gets both back, announcing
+// itself with the floor it stands at
+static void Fail(BuildingObj *building, bool failed)
+{
+  CarModelObj *model = &building->Cars[0];
+  char frame[BUILDING_FRAME];
+  int size;
+
+  building->Failed = failed;
+  if (failed)
+  {
+    model->Motion = 0;
+    model->DoorTarget = 0;
+    model->DoorQueued = 0;
+    return;
+  }
+  size = snprintf(frame, sizeof(frame), "%c%d", CENTRAL_ELEVATOR, FloorAt(model));
+  Say(building, 0, frame, size);
+}
+
+static int FloorAt(const CarModelObj *model)
+{
+  return (model->Position + BUILDING_FLOOR_HEIGHT / 2) / BUILDING_FLOOR_HEIGHT;
+}
+
+static bool AtFloor(const CarModelObj *model)
+{
+  return model->Position % BUILDING_FLOOR_HEIGHT == 0;
+}
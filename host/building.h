@@ -0,0 +1,140 @@
+#ifndef BUILDING_H
+#define BUILDING_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *      Building Model
+ *
+ * Stand-in for the course simulator: the cars, doors, buttons and passengers
+ * of a FLOORS floor building speaking the protocol at the top of misc.h. The
+ * owner feeds it the frames the controller sends (BuildingCommand) and steps
+ * it one ms at a time (BuildingStep). It sends its own frames, floor
+ * reports, acks and button presses, through the Send hook once their link
+ * latency has passed. Time is whatever the owner says it is, so the model
+ * runs as fast as it is stepped.
+ *
+ * Include misc.h first.
+ *---------------------------------------------------------------------------*/
+
+#define BUILDING_CARS 3                          // 'c', 'd' and 'e'
+#define BUILDING_FLOOR_HEIGHT (MAX_HEIGHT / (FLOORS - 1) * 1000) // um between two floors
+#define BUILDING_PASSENGERS 4096                 // passengers in the building at once
+#define BUILDING_LEVEL 500000                    // um from a floor a stopped car re-levels from
+#define BUILDING_FRAMES 256                      // frames on the link at once, each way
+#define BUILDING_FRAME 8                         // bytes of a frame, without END_COMMAND
+#define BUILDING_DOORS 4                         // door commands a car queues behind the moving one
+#define BUILDING_REPRESS 10000                   // ms a passenger waits on an unlit button before pressing again
+#define BUILDING_BUCKET 5000                     // ms of each bucket of the wait histogram
+#define BUILDING_BUCKETS 256                     // buckets, the last one open
+#define BUILDING_FLOOR_ENERGY 30.0               // kJ to travel one floor at speed
+#define BUILDING_START_ENERGY 15.0               // kJ more to bring a car up to speed
+
+#define PASSENGER_FREE 0
+#define PASSENGER_WAITING 1
+#define PASSENGER_RIDING 2
+
+typedef struct {                                 // building configuration data type
+  int Cars;                                      // cars passengers use, from 'c'
+  uint32_t FloorTime;                            // ms per floor at speed
+  uint32_t DoorTime;                             // ms the door takes to open or close
+  uint32_t Latency;                              // ms a frame spends on the link, each way
+  double Arrivals;                               // passengers per minute, whole building
+  double Lobby;                                  // share of them starting at the exit floor
+  double Reopen;                                 // chance a close is undone by an obstruction
+  int Capacity;                                  // passengers per car
+  uint32_t Mash;                                 // ms between presses of a waiting passenger, lit or not, 0 for none
+  uint32_t FailAt;                               // ms car 'c' stops answering, 0 never
+  uint32_t FailFor;                              // ms it stays silent
+  uint32_t EvacuateAt;                           // ms the fire panel sends EVACUATE, 0 never
+  int Occupants;                                 // people on each floor above the exit then
+  uint32_t Seed;
+} BuildingConfigObj;
+
+typedef struct {                                 // car model data type
+  int32_t Position;                              // um above the exit floor
+  int Motion;                                    // +1 up, -1 down, 0 stopped
+  bool Homing;                                   // going down after INIT_ELEVATOR, no reports
+  char Held;                                     // move asked for while homing, run once home
+  uint32_t Resets;                               // INIT_ELEVATOR frames received
+  char Door;                                     // OPEN or CLOSED
+  char DoorTarget;                               // where the door is going, 0 when still
+  uint32_t DoorDone;                             // ms it gets there
+  char DoorQueue[BUILDING_DOORS];                // commands run once the door is still, in order
+  int DoorQueued;
+  uint16_t Lights;                               // button lights, one bit per floor
+  int Load;                                      // passengers aboard
+  uint64_t Travelled;                            // um, for the energy figure
+  uint32_t Starts;                               // moves from standstill
+  uint32_t DoorCycles;                           // door openings
+  uint32_t Reopened;                             // closes undone by an obstruction
+} CarModelObj;
+
+typedef struct {                                 // passenger data type
+  uint8_t Car;                                   // index of the car used
+  uint8_t Origin;                                // floor index
+  uint8_t Destination;
+  uint8_t State;                                 // PASSENGER_FREE, _WAITING or _RIDING
+  bool Evacuee;                                  // placed by the evacuation, counted apart
+  uint32_t Arrival;                              // ms at the hall button
+  uint32_t Board;                                // ms through the car door
+  uint32_t Pressed;                              // ms of the last button press
+} PassengerObj;
+
+typedef struct {                                 // frame on the link data type
+  uint32_t Due;
+  int Size;
+  char Frame[BUILDING_FRAME];
+} LinkFrameObj;
+
+typedef struct {                                 // one way of the link data type
+  LinkFrameObj Frames[BUILDING_FRAMES];
+  int Head;
+  int Count;
+  uint32_t Dropped;                              // frames lost to a full link
+} LinkObj;
+
+typedef struct {                                 // results data type
+  uint32_t Served;                               // passengers delivered
+  uint64_t WaitTotal;                            // ms, arrival to boarding
+  uint64_t TripTotal;                            // ms, arrival to alighting
+  uint32_t WaitMax;
+  uint32_t Waits[BUILDING_BUCKETS];              // histogram of the waits
+  uint32_t Unserved;                             // still waiting or riding at the end
+  uint32_t Refused;                              // arrivals past BUILDING_PASSENGERS
+  uint32_t EvacuationLeft;                       // occupants not yet out
+  uint32_t EvacuationTime;                       // ms from EVACUATE to the last one out, 0 if not yet
+} BuildingStatsObj;
+
+typedef struct {                                 // building data type
+  BuildingConfigObj Config;
+  CarModelObj Cars[BUILDING_CARS];
+  PassengerObj Passengers[BUILDING_PASSENGERS];
+  int PassengerCount;
+  LinkObj ToController;
+  LinkObj FromController;
+  BuildingStatsObj Stats;
+  uint32_t Now;
+  uint32_t NextArrival;
+  uint64_t Random;                               // arrivals, the same for the same seed whatever the cars do
+  uint64_t Obstructions;                         // door reopens, drawn apart from the arrivals
+  bool Evacuating;
+  bool Failed;                                   // car 'c' silent
+  void (*Send)(void *context, const char *frame, int size); // frame to the controller, without END_COMMAND
+  void *Context;
+} BuildingObj;
+
+void BuildingDefaults(BuildingConfigObj *config);
+void BuildingInit(BuildingObj *building, const BuildingConfigObj *config);
+void BuildingCommand(BuildingObj *building, const char *frame, int size);
+void BuildingStep(BuildingObj *building, uint32_t now);
+void BuildingArrive(BuildingObj *building, int car, int origin, int destination);
+bool BuildingIdle(const BuildingObj *building);
+void BuildingFinish(BuildingObj *building);
+uint32_t BuildingPercentile(const BuildingStatsObj *stats, double share);
+double BuildingEnergy(const BuildingObj *building);
+void BuildingReport(const BuildingObj *building, FILE *file);
+
+#endif
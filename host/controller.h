@@ -0,0 +1,79 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cmsis_os2.h"
+
+#include "misc.h"
+#include "profile.h"
+
+/*----------------------------------------------------------------------------
+ *      Controller
+ *
+ * Functions and state of main.c used by the host tools. main.c is built with
+ * -Dmain=ControllerMain so the tools keep their own entry point, and with
+ * -DUSE_RTOS=0 for the bare-metal event loop.
+ *---------------------------------------------------------------------------*/
+
+#ifndef USE_RTOS
+#define USE_RTOS 1
+#endif
+
+int ControllerMain(void);
+
+void SetupController(void);
+void UARTIntHandler(void);
+void ReceiveFrame(MsgObj *msg, uint32_t timeout);
+bool RingPut(RingObj *ring, MsgObj *msg);
+bool RingGet(RingObj *ring, MsgObj *msg);
+
+void CentralCommand(ElevatorObj *elevator, MsgObj *msg);
+void CentralResponse(ElevatorObj *elevator, MsgObj *msg);
+void CentralArrival(ElevatorObj *elevator);
+void Reoptimize(ElevatorObj *elevator);
+uint32_t PlanCost(ElevatorObj *elevator, char direction);
+
+void ChangeDoorStatus(char elevator, char status);
+void ChangeButtonStatus(char elevator, char floor, char status);
+char GetFloorCharFromFloorNumberString(char floorNumber, char isHigher);
+
+void PublishSnapshot(ElevatorObj *elevator);
+void ReadSnapshot(SnapshotObj *snapshot);
+
+void TelemetryFlush(void);
+int CobsEncode(const uint8_t *data, int size, uint8_t *frame);
+uint16_t Crc16(const uint8_t *data, int size);
+
+#if USE_RTOS
+extern osMessageQueueId_t qidMain;
+extern osMessageQueueId_t qidCentralCommands;
+extern osMessageQueueId_t qidCentralResponses;
+#else
+extern RingObj ringMain;
+extern RingObj ringCentralCommands;
+extern RingObj ringCentralResponses;
+#endif
+extern uint32_t centralCalls;
+extern uint32_t centralStops;
+extern uint32_t centralTrips;
+extern uint32_t collapsedCalls[ELEVATORS];
+extern uint32_t rejectedCalls;
+extern ProbeObj probeUart;
+extern ProbeObj probeCentral;
+extern ProbeObj probeSend;
+extern ProbeObj probeCloseToMove;
+extern uint32_t countFrames;
+extern uint32_t countBytes;
+extern uint32_t countTimeouts;
+extern uint32_t countOverflows;
+extern uint32_t telemetryRecords;
+extern uint32_t telemetryBytes;
+extern uint32_t telemetryDropped;
+extern LatchObj centralLatch;
+extern uint32_t snapshotRetries;
+extern uint32_t outageTime[ELEVATORS];
+extern uint32_t outages[ELEVATORS];
+
+#endif
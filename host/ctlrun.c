@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "inc/hw_memmap.h"
+
+#include "target.h"
+#include "controller.h"
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Transmit(uint32_t base, unsigned char byte);
+static void Idle(void);
+static void Finish(void);
+static void Stop(int signal);
+static double Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static int line = -1;
+static double speed = 1;
+static double startTime;
+static uint32_t endTick;
+static uint32_t sent;
+static uint32_t received;
+static char txFrame[16];
+static int txSize;
+static volatile sig_atomic_t stopping;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// The controller on a serial line: UART0 is the terminal given,
+// a pty of build/sim or a real port to the course simulator, and its ticks
+// follow the wall clock, -x times faster to keep pace with an accelerated
+// simulator. Runs for -s seconds of controller time or until the line hangs
+// up or SIGTERM
+int main(int argc, char **argv)
+{
+  struct termios termios;
+  uint32_t seconds = 0;
+  int option;
+
+  while ((option = getopt(argc, argv, "x:s:")) != -1)
+  {
+    if (option == 'x')
+      speed = atof(optarg);
+    else if (option == 's')
+      seconds = (uint32_t)atoi(optarg);
+    else
+      break;
+  }
+  if (option != -1 || optind >= argc || speed <= 0)
+  {
+    fprintf(stderr, "usage: %s [-x speed] [-s seconds] tty\n", argv[0]);
+    return 2;
+  }
+  if ((line = open(argv[optind], O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  if (tcgetattr(line, &termios) == 0)
+  {
+    cfmakeraw(&termios);
+    cfsetspeed(&termios, B115200);
+    tcsetattr(line, TCSANOW, &termios);
+  }
+  signal(SIGINT, Stop);
+  signal(SIGTERM, Stop);
+
+  endTick = seconds * 1000;
+  host.Transmit = Transmit;
+  host.Idle = Idle;
+  startTime = Now();
+  ControllerMain();
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Line Functions
+ *---------------------------------------------------------------------------*/
+
+// A whole frame per write, the way the simulator reads them
+static void Transmit(uint32_t base, unsigned char byte)
+{
+  if (base != UART0_BASE)
+  {
+    return;
+  }
+  if (txSize < (int)sizeof(txFrame))
+  {
+    txFrame[txSize++] = (char)byte;
+  }
+  if (byte == END_COMMAND)
+  {
+    if (write(line, txFrame, (size_t)txSize) == txSize)
+    {
+      sent++;
+    }
+    txSize = 0;
+  }
+}
+
+// Waits on the line until the next tick is due, handing over bytes as soon
+// as they arrive so the controller answers between ticks as it would on the
+// board
+static void Idle()
+{
+  char bytes[256];
+  double due = startTime + (HostTicks() + 1) / speed / 1000;
+  double wait = due - Now();
+  struct pollfd poller = {line, POLLIN, 0};
+  ssize_t size;
+  int i;
+
+  if (stopping || (endTick && HostTicks() >= endTick))
+  {
+    Finish();
+  }
+
+  if (poll(&poller, 1, wait > 0 ? (int)(wait * 1000) : 0) > 0)
+  {
+    if (poller.revents & (POLLHUP | POLLERR))
+    {
+      Finish();
+    }
+    if ((size = read(line, bytes, sizeof(bytes))) > 0)
+    {
+      for (i = 0; i < size; i++)
+      {
+        received += bytes[i] == END_COMMAND;
+      }
+      HostReceive(UART0_BASE, bytes, (int)size);
+      return;
+    }
+  }
+  if (Now() >= due)
+  {
+    HostTick(1);
+  }
+}
+
+static void Finish()
+{
+  double seconds = Now() - startTime;
+
+  fprintf(stderr, "controller: %u ms in %.2f s, %u frames received, %u sent, %u overruns\n", HostTicks(), seconds,
+          received, sent, hostUart[0].Overruns);
+  exit(0);
+}
+
+static void Stop(int signal)
+{
+  stopping = 1;
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,47 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *      Fleet Ring File
+ *
+ * One file per controller, written by the aggregator and mapped by readers.
+ * A header and then FleetHeaderObj.Capacity records, record n in slot
+ * n % Capacity. The aggregator is the only writer: it fills the slot, then
+ * publishes it by advancing Head with release order. A reader loads Head
+ * with acquire order, reads records in place, and knows one was overwritten
+ * under it when Head has since moved more than Capacity past it. Include
+ * misc.h first, for TELEMETRY_RECORD.
+ *---------------------------------------------------------------------------*/
+
+#define FLEET_MAGIC 0x464C5452U  // "RTLF" in the first four bytes
+#define FLEET_VERSION 1
+
+typedef struct {                 // ring file header data type, one cache line
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t RecordSize;           // sizeof(FleetRecordObj)
+  uint32_t Capacity;             // records, a power of two
+  uint32_t Controller;           // id from the last announce, 0 until one arrives
+  uint32_t Reserved;
+  _Atomic uint64_t Head;         // records ever appended
+  uint64_t Bytes;                // bytes read from the line
+  uint64_t BadFrames;            // frames dropped for their length or CRC
+  uint64_t Gaps;                 // records missing from the sequence
+  uint8_t Pad[8];
+} FleetHeaderObj;
+
+typedef struct {                 // ring record data type
+  uint64_t Time;                 // ns since the epoch when the frame was decoded
+  uint8_t Size;                  // bytes of Payload used
+  uint8_t Payload[TELEMETRY_RECORD - 2]; // decoded record, CRC checked and removed
+  uint8_t Pad[6];
+} FleetRecordObj;
+
+// Header and records of a mapped ring file
+#define FLEET_RECORDS(header) ((FleetRecordObj *)((uint8_t *)(header) + sizeof(FleetHeaderObj)))
+#define FLEET_FILE_SIZE(capacity) (sizeof(FleetHeaderObj) + (size_t)(capacity) * sizeof(FleetRecordObj))
+
+#endif
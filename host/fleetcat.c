@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "misc.h"
+
+#include "telemetry.h"
+#include "fleet.h"
+
+#define FLEETCAT_POLL 100       // ms between two looks at the head when following
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Stop(int signal);
+static FleetHeaderObj *MapRing(const char *path);
+static uint64_t Print(const FleetHeaderObj *ring, uint64_t from);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static volatile sig_atomic_t stopping;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Prints the records still held by ring files of the aggregator, oldest
+// first, and with -f keeps printing new ones as they are appended. Reading
+// takes no lock: the aggregator never waits for a reader
+int main(int argc, char **argv)
+{
+  struct timespec poll = {0, FLEETCAT_POLL * 1000000L};
+  struct sigaction action;
+  FleetHeaderObj **rings;
+  uint64_t *next;
+  bool follow = false;
+  int count;
+  int option;
+  int i;
+
+  while ((option = getopt(argc, argv, "f")) != -1)
+  {
+    if (option != 'f')
+    {
+      fprintf(stderr, "usage: %s [-f] ring...\n", argv[0]);
+      return 2;
+    }
+    follow = true;
+  }
+  count = argc - optind;
+  if (count == 0)
+  {
+    fprintf(stderr, "usage: %s [-f] ring...\n", argv[0]);
+    return 2;
+  }
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = Stop;
+  sigaction(SIGINT, &action, NULL);
+
+  rings = calloc((size_t)count, sizeof(FleetHeaderObj *));
+  next = calloc((size_t)count, sizeof(uint64_t));
+  for (i = 0; i < count; i++)
+  {
+    if ((rings[i] = MapRing(argv[optind + i])) == NULL)
+    {
+      return 1;
+    }
+    next[i] = Print(rings[i], 0);
+  }
+
+  while (follow && !stopping)
+  {
+    nanosleep(&poll, NULL);
+    for (i = 0; i < count; i++)
+    {
+      next[i] = Print(rings[i], next[i]);
+    }
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    printf("# controller %u: %llu records, %llu bytes, %llu bad frames, %llu missing\n",
+           (unsigned)rings[i]->Controller,
+           (unsigned long long)atomic_load_explicit(&rings[i]->Head, memory_order_acquire),
+           (unsigned long long)rings[i]->Bytes, (unsigned long long)rings[i]->BadFrames,
+           (unsigned long long)rings[i]->Gaps);
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Reader Functions
+ *---------------------------------------------------------------------------*/
+
+static void Stop(int signal)
+{
+  stopping = 1;
+}
+
+static FleetHeaderObj *MapRing(const char *path)
+{
+  FleetHeaderObj *ring;
+  struct stat status;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &status) < 0 || (size_t)status.st_size < sizeof(FleetHeaderObj))
+  {
+    fprintf(stderr, "%s: %s\n", path, fd < 0 ? strerror(errno) : "not a ring file");
+    return NULL;
+  }
+  ring = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED)
+  {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  if (ring->Magic != FLEET_MAGIC || ring->Version != FLEET_VERSION
+      || ring->RecordSize != sizeof(FleetRecordObj)
+      || (size_t)status.st_size < FLEET_FILE_SIZE(ring->Capacity))
+  {
+    fprintf(stderr, "%s: not a version %d ring file\n", path, FLEET_VERSION);
+    return NULL;
+  }
+  return ring;
+}
+
+// Records from..head still in the ring. A slot is copied out and then the
+// head checked again: if the writer lapped it in between, the copy is torn
+// and skipped. Returns where the next call carries on
+static uint64_t Print(const FleetHeaderObj *ring, uint64_t from)
+{
+  const FleetRecordObj *records = FLEET_RECORDS(ring);
+  uint64_t head = atomic_load_explicit(&((FleetHeaderObj *)ring)->Head, memory_order_acquire);
+  FleetRecordObj record;
+  TelemetryObj telemetry;
+
+  if (head - from > ring->Capacity)
+  {
+    from = head - ring->Capacity;
+  }
+  for (; from < head; from++)
+  {
+    record = records[from & (ring->Capacity - 1)];
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&((FleetHeaderObj *)ring)->Head, memory_order_relaxed) - from > ring->Capacity)
+    {
+      continue;
+    }
+    if (!TelemetryParse(record.Payload, record.Size, &telemetry))
+    {
+      printf("%llu.%09llu ? %d bytes\n", (unsigned long long)(record.Time / 1000000000ULL),
+             (unsigned long long)(record.Time % 1000000000ULL), record.Size);
+    }
+    else if (telemetry.Car == TELEMETRY_ANNOUNCE)
+    {
+      printf("%llu.%09llu %3u controller %u dropped %u\n",
+             (unsigned long long)(record.Time / 1000000000ULL),
+             (unsigned long long)(record.Time % 1000000000ULL), telemetry.Sequence,
+             telemetry.Controller, telemetry.Dropped);
+    }
+    else if (telemetry.Car == TELEMETRY_CAPTURE)
+    {
+      printf("%llu.%09llu %3u capture ", (unsigned long long)(record.Time / 1000000000ULL),
+             (unsigned long long)(record.Time % 1000000000ULL), telemetry.Sequence);
+      if (telemetry.Direction == CAPTURE_START)
+        printf("of %u frames\n", telemetry.Count);
+      else
+        printf("%c %u ms %.*s\n", telemetry.Direction, telemetry.Time, telemetry.Size, telemetry.Command);
+    }
+    else
+    {
+      printf("%llu.%09llu %3u car %c", (unsigned long long)(record.Time / 1000000000ULL),
+             (unsigned long long)(record.Time % 1000000000ULL), telemetry.Sequence, telemetry.Car);
+      if (telemetry.Flags & TELEMETRY_FLOOR)
+        printf(" floor %u", telemetry.Floor);
+      if (telemetry.Flags & TELEMETRY_DOOR)
+        printf(" door %c", telemetry.Door);
+      if (telemetry.Flags & TELEMETRY_DIRECTION)
+        printf(" direction %c", telemetry.Direction);
+      if (telemetry.Flags & TELEMETRY_STOPS)
+        printf(" stops %04x", telemetry.Stops);
+      printf("\n");
+    }
+  }
+  fflush(stdout);
+  return head;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <setjmp.h>
+
+#include "inc/hw_memmap.h"
+
+#include "target.h"
+#include "controller.h"
+#include "building.h"
+#include "harness.h"
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Transmit(uint32_t base, unsigned char byte);
+static void Idle(void);
+static void Send(void *context, const char *frame, int size);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static BuildingObj *harnessBuilding;
+static uint32_t harnessUntil;
+static bool (*harnessDone)(const BuildingObj *building);
+static jmp_buf harnessEnd;
+static char txFrame[16];        // frame the controller is sending on UART0
+static int txSize;
+
+/*----------------------------------------------------------------------------
+ *      Harness Functions
+ *---------------------------------------------------------------------------*/
+
+// The controller never returns: Idle, run by the RTX scheduler with every
+// thread blocked or by __WFI in the event loop, leaves it with a longjmp
+// once the run is over
+void HarnessRun(BuildingObj *building, uint32_t until, bool (*done)(const BuildingObj *building))
+{
+  harnessBuilding = building;
+  harnessUntil = until;
+  harnessDone = done;
+  building->Send = Send;
+  building->Context = NULL;
+  host.Transmit = Transmit;
+  host.Idle = Idle;
+  if (setjmp(harnessEnd) == 0)
+  {
+    ControllerMain();
+  }
+  host.Transmit = NULL;
+  host.Idle = NULL;
+}
+
+// Only UART0 reaches the model. Frames are queued on the link, not acted on,
+// so nothing is sent back from inside the ISR or a masked section
+static void Transmit(uint32_t base, unsigned char byte)
+{
+  if (base != UART0_BASE)
+  {
+    return;
+  }
+  if (byte != END_COMMAND)
+  {
+    if (txSize < (int)sizeof(txFrame))
+    {
+      txFrame[txSize++] = (char)byte;
+    }
+    return;
+  }
+  BuildingCommand(harnessBuilding, txFrame, txSize);
+  txSize = 0;
+}
+
+// One ms for the controller and the model
+static void Idle()
+{
+  HostTick(1);
+  BuildingStep(harnessBuilding, HostTicks());
+  if ((int32_t)(HostTicks() - harnessUntil) >= 0 || (harnessDone && harnessDone(harnessBuilding)))
+  {
+    longjmp(harnessEnd, 1);
+  }
+}
+
+static void Send(void *context, const char *frame, int size)
+{
+  char bytes[BUILDING_FRAME + 1];
+  int i;
+
+  for (i = 0; i < size; i++)
+  {
+    bytes[i] = frame[i];
+  }
+  bytes[size] = END_COMMAND;
+  HostReceive(UART0_BASE, bytes, size + 1);
+}
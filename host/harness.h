@@ -0,0 +1,23 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *      Harness
+ *
+ * The controller driving a building model in the same process: its
+ * UART0 frames go to BuildingCommand, the model's frames come back
+ * through the UART0 receive interrupt, and both share the host tick, so a
+ * simulated day takes seconds. The controller keeps its state in globals and
+ * never returns, so HarnessRun can be called once per process; tools that
+ * compare runs fork one child per run.
+ *
+ * Include misc.h and building.h first.
+ *---------------------------------------------------------------------------*/
+
+// Runs until the tick reaches until or done, when set, returns true
+void HarnessRun(BuildingObj *building, uint32_t until, bool (*done)(const BuildingObj *building));
+
+#endif
@@ -0,0 +1,19 @@
+// Host stand-in for the TM4C129 device header: the core intrinsics main.c
+// uses
+
+#ifndef TM4C129_H
+#define TM4C129_H
+
+#include <stdint.h>
+
+extern uint32_t SystemCoreClock;
+
+void __WFI(void);                               // runs host.Idle
+uint32_t ITM_SendChar(uint32_t ch);             // runs host.Trace
+
+static inline void __DMB(void)
+{
+  __sync_synchronize();
+}
+
+#endif
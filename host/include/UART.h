@@ -0,0 +1,10 @@
+// Host stand-in for the course UART0 driver (Drivers/UART.h)
+
+#ifndef UART_DRIVER_H
+#define UART_DRIVER_H
+
+void UART_Init(void);
+char UART_InChar(void);
+void UART_OutChar(char data);
+
+#endif
@@ -0,0 +1,76 @@
+// Host stand-in for the CMSIS-RTOS2 API, implemented without threads in
+// rtos.c: the threads take turns, each one running until it blocks
+
+#ifndef CMSIS_OS2_H_
+#define CMSIS_OS2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define osWaitForever 0xFFFFFFFFU
+
+typedef enum {
+  osOK = 0,
+  osError = -1,
+  osErrorTimeout = -2,
+  osErrorResource = -3,
+  osErrorParameter = -4
+} osStatus_t;
+
+typedef enum {
+  osKernelInactive = 0,
+  osKernelReady = 1,
+  osKernelRunning = 2
+} osKernelState_t;
+
+typedef enum {
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40
+} osPriority_t;
+
+typedef enum {
+  osTimerOnce = 0,
+  osTimerPeriodic = 1
+} osTimerType_t;
+
+typedef void *osThreadId_t;
+typedef void *osTimerId_t;
+typedef void *osMessageQueueId_t;
+
+typedef void (*osThreadFunc_t)(void *argument);
+typedef void (*osTimerFunc_t)(void *argument);
+
+typedef struct {
+  const char *name;
+  uint32_t attr_bits;
+  void *cb_mem;
+  uint32_t cb_size;
+  void *stack_mem;
+  uint32_t stack_size;
+  osPriority_t priority;
+  uint32_t tz_module;
+  uint32_t reserved;
+} osThreadAttr_t;
+
+osStatus_t osKernelInitialize(void);
+osKernelState_t osKernelGetState(void);
+osStatus_t osKernelStart(void);
+uint32_t osKernelGetTickCount(void);
+
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument, const osThreadAttr_t *attr);
+osStatus_t osDelay(uint32_t ticks);
+
+osTimerId_t osTimerNew(osTimerFunc_t func, osTimerType_t type, void *argument, const void *attr);
+osStatus_t osTimerStart(osTimerId_t timer, uint32_t ticks);
+
+osMessageQueueId_t osMessageQueueNew(uint32_t count, uint32_t size, const void *attr);
+osStatus_t osMessageQueuePut(osMessageQueueId_t queue, const void *msg, uint8_t priority, uint32_t timeout);
+osStatus_t osMessageQueueGet(osMessageQueueId_t queue, void *msg, uint8_t *priority, uint32_t timeout);
+uint32_t osMessageQueueGetCount(osMessageQueueId_t queue);
+uint32_t osMessageQueueGetSpace(osMessageQueueId_t queue);
+osStatus_t osMessageQueueReset(osMessageQueueId_t queue);
+
+#endif
@@ -0,0 +1,17 @@
+// Host stand-in for TivaWare driverlib/eeprom.h, a file-backed image in
+// target.c
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stdint.h>
+
+#define EEPROM_INIT_OK 0
+#define EEPROM_INIT_ERROR 2
+
+uint32_t EEPROMInit(void);
+uint32_t EEPROMSizeGet(void);
+void EEPROMRead(uint32_t *data, uint32_t address, uint32_t count);
+uint32_t EEPROMProgram(uint32_t *data, uint32_t address, uint32_t count);
+
+#endif
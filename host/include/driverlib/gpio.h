@@ -0,0 +1,14 @@
+// Host stand-in for TivaWare driverlib/gpio.h
+
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <stdint.h>
+
+#define GPIO_PIN_0 0x00000001
+#define GPIO_PIN_1 0x00000002
+
+void GPIOPinConfigure(uint32_t pinConfig);
+void GPIOPinTypeUART(uint32_t port, uint8_t pins);
+
+#endif
@@ -0,0 +1,15 @@
+// Host stand-in for TivaWare driverlib/interrupt.h
+
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool IntMasterEnable(void);
+bool IntMasterDisable(void);
+void IntRegister(uint32_t interrupt, void (*handler)(void));
+void IntEnable(uint32_t interrupt);
+void IntDisable(uint32_t interrupt);
+
+#endif
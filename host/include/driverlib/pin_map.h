@@ -0,0 +1,9 @@
+// Host stand-in for TivaWare driverlib/pin_map.h
+
+#ifndef PIN_MAP_H
+#define PIN_MAP_H
+
+#define GPIO_PB0_U1RX 0x00010001
+#define GPIO_PB1_U1TX 0x00010401
+
+#endif
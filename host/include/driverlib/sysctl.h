@@ -0,0 +1,16 @@
+// Host stand-in for TivaWare driverlib/sysctl.h
+
+#ifndef SYSCTL_H
+#define SYSCTL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYSCTL_PERIPH_EEPROM0 0xf0005800
+#define SYSCTL_PERIPH_GPIOB 0xf0000801
+#define SYSCTL_PERIPH_UART1 0xf0001801
+
+void SysCtlPeripheralEnable(uint32_t peripheral);
+bool SysCtlPeripheralReady(uint32_t peripheral);
+
+#endif
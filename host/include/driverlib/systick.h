@@ -0,0 +1,13 @@
+// Host stand-in for TivaWare driverlib/systick.h, ticked by HostTick
+
+#ifndef SYSTICK_H
+#define SYSTICK_H
+
+#include <stdint.h>
+
+void SysTickPeriodSet(uint32_t period);
+void SysTickIntRegister(void (*handler)(void));
+void SysTickIntEnable(void);
+void SysTickEnable(void);
+
+#endif
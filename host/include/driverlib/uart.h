@@ -0,0 +1,44 @@
+// Host stand-in for TivaWare driverlib/uart.h, backed by the UART model of
+// target.c
+
+#ifndef UART_H
+#define UART_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define UART_INT_OE 0x400
+#define UART_INT_RT 0x040
+#define UART_INT_TX 0x020
+#define UART_INT_RX 0x010
+
+#define UART_FIFO_TX1_8 0x00
+#define UART_FIFO_TX2_8 0x01
+#define UART_FIFO_TX4_8 0x02
+#define UART_FIFO_TX6_8 0x03
+#define UART_FIFO_TX7_8 0x04
+
+#define UART_FIFO_RX1_8 0x00
+#define UART_FIFO_RX2_8 0x08
+#define UART_FIFO_RX4_8 0x10
+#define UART_FIFO_RX6_8 0x18
+#define UART_FIFO_RX7_8 0x20
+
+#define UART_CONFIG_WLEN_8 0x00000060
+#define UART_CONFIG_STOP_ONE 0x00000000
+#define UART_CONFIG_PAR_NONE 0x00000000
+
+void UARTConfigSetExpClk(uint32_t base, uint32_t uartClk, uint32_t baud, uint32_t config);
+void UARTEnable(uint32_t base);
+void UARTFIFOEnable(uint32_t base);
+void UARTFIFOLevelSet(uint32_t base, uint32_t txLevel, uint32_t rxLevel);
+void UARTIntEnable(uint32_t base, uint32_t intFlags);
+uint32_t UARTIntStatus(uint32_t base, bool masked);
+void UARTIntClear(uint32_t base, uint32_t intFlags);
+bool UARTCharsAvail(uint32_t base);
+bool UARTSpaceAvail(uint32_t base);
+int32_t UARTCharGetNonBlocking(uint32_t base);
+bool UARTCharPutNonBlocking(uint32_t base, unsigned char data);
+void UARTCharPut(uint32_t base, unsigned char data);
+
+#endif
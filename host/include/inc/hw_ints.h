@@ -0,0 +1,10 @@
+// Host stand-in for TivaWare inc/hw_ints.h, only what main.c uses
+
+#ifndef HW_INTS_H
+#define HW_INTS_H
+
+#define INT_UART0 21            // UART0 Rx and Tx
+#define INT_UART1 22            // UART1 Rx and Tx
+#define NUM_INTERRUPTS 130
+
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in for TivaWare inc/hw_memmap.h, only what main.c uses
+
+#ifndef HW_MEMMAP_H
+#define HW_MEMMAP_H
+
+#define UART0_BASE 0x4000C000
+#define UART1_BASE 0x4000D000
+#define GPIO_PORTB_BASE 0x40059000
+
+#endif
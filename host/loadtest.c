@@ -0,0 +1,378 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "controller.h"
+#include "telemetry.h"
+#include "fleet.h"
+
+#define LOADTEST_LINES 8        // most controllers by default
+#define LOADTEST_SECONDS 2      // s of traffic for each line count
+#define LOADTEST_BAUD 115200    // UART1 rate, 10 bits a byte on the line
+#define LOADTEST_BATCH 32       // frames per write
+#define LOADTEST_SETTLE 2000    // ms allowed for the aggregator to catch up
+
+typedef struct {                // simulated controller data type
+  pthread_t Thread;
+  int Fd;                       // pty master, the aggregator opens the slave
+  char Path[64];
+  uint8_t Id;
+  uint64_t Frames;              // frames written
+  uint64_t Bytes;
+} LineObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static int OpenLine(LineObj *line);
+static pid_t StartAggregator(const char *program, const char *directory, int threads,
+                             LineObj *lines, int count);
+static FleetHeaderObj *WaitRing(const char *directory, int index);
+static uint64_t Ingested(FleetHeaderObj **rings, int count, uint64_t *bad);
+static int Encode(uint8_t id, uint8_t sequence, uint32_t step, uint8_t *frame);
+static void *Writer(void *argument);
+static double Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static bool flood;              // write as fast as the aggregator reads
+static double seconds = LOADTEST_SECONDS;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Runs build/aggregator against 1, 2, 4 ... pseudo terminals, each fed the
+// telemetry of one controller at the UART1 line rate (or flat out with -f),
+// and reports what was offered against what reached the ring files, and the
+// CPU the aggregator used for it
+int main(int argc, char **argv)
+{
+  const char *program = "build/aggregator";
+  char directory[] = "/tmp/loadtest-XXXXXX";
+  LineObj lines[256];
+  FleetHeaderObj *rings[256];
+  struct rusage usage;
+  uint64_t offered;
+  uint64_t ingested;
+  uint64_t bad;
+  double start;
+  double sending;
+  double wall;
+  double cpu;
+  pid_t child;
+  int status;
+  int most = LOADTEST_LINES;
+  int threads = 0;
+  int option;
+  int count;
+  int i;
+
+  while ((option = getopt(argc, argv, "a:n:s:t:f")) != -1)
+  {
+    if (option == 'a')
+      program = optarg;
+    else if (option == 'n')
+      most = atoi(optarg);
+    else if (option == 's')
+      seconds = atof(optarg);
+    else if (option == 't')
+      threads = atoi(optarg);
+    else if (option == 'f')
+      flood = true;
+    else
+    {
+      fprintf(stderr, "usage: %s [-a aggregator] [-n lines] [-s seconds] [-t threads] [-f]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (most < 1 || most > 256 || !mkdtemp(directory))
+  {
+    fprintf(stderr, "%s: bad line count or no temporary directory\n", argv[0]);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%d online cpus, %s\n", (int)sysconf(_SC_NPROCESSORS_ONLN), flood ? "flood" : "line rate");
+  printf("%6s %14s %14s %10s %6s %8s\n", "lines", "offered rec/s", "ingested rec/s", "lost", "bad", "cpu %");
+  fflush(stdout);
+  for (count = 1; count <= most; count = (count * 2 > most && count < most) ? most : count * 2)
+  {
+    for (i = 0; i < count; i++)
+    {
+      memset(&lines[i], 0, sizeof(LineObj));
+      lines[i].Id = (uint8_t)(i + 1);
+      if (OpenLine(&lines[i]) < 0)
+      {
+        perror("pty");
+        return 1;
+      }
+    }
+    child = StartAggregator(program, directory, threads, lines, count);
+    for (i = 0; i < count; i++)
+    {
+      if ((rings[i] = WaitRing(directory, i)) == NULL)
+      {
+        fprintf(stderr, "%s did not create its ring files\n", program);
+        kill(child, SIGTERM);
+        return 1;
+      }
+    }
+
+    start = Now();
+    for (i = 0; i < count; i++)
+    {
+      pthread_create(&lines[i].Thread, NULL, Writer, &lines[i]);
+    }
+    offered = 0;
+    for (i = 0; i < count; i++)
+    {
+      pthread_join(lines[i].Thread, NULL);
+      offered += lines[i].Frames;
+    }
+
+    // What is still in the pty buffers is given time to drain before the
+    // masters are closed, which hangs up the lines and ends the aggregator
+    sending = Now() - start;
+    while (Ingested(rings, count, &bad) < offered && Now() - start < sending + LOADTEST_SETTLE / 1000.0)
+    {
+      usleep(1000);
+    }
+    wall = Now() - start;
+    for (i = 0; i < count; i++)
+    {
+      close(lines[i].Fd);
+    }
+    if (wait4(child, &status, 0, &usage) < 0)
+    {
+      perror("wait4");
+      return 1;
+    }
+    cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    ingested = Ingested(rings, count, &bad);
+
+    printf("%6d %14.0f %14.0f %10llu %6llu %8.1f\n", count, offered / sending, ingested / wall,
+           (unsigned long long)(offered - ingested), (unsigned long long)bad, 100.0 * cpu / wall);
+    fflush(stdout);
+    for (i = 0; i < count; i++)
+    {
+      munmap(rings[i], FLEET_FILE_SIZE(rings[i]->Capacity));
+    }
+  }
+
+  for (i = 0; i < most; i++)
+  {
+    char path[sizeof(directory) + 32];
+
+    snprintf(path, sizeof(path), "%s/fleet-%03d.ring", directory, i);
+    unlink(path);
+  }
+  rmdir(directory);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Load Functions
+ *---------------------------------------------------------------------------*/
+
+// A raw pty, so the line discipline neither echoes nor rewrites a byte
+static int OpenLine(LineObj *line)
+{
+  struct termios mode;
+  int slave;
+
+  line->Fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (line->Fd < 0 || grantpt(line->Fd) < 0 || unlockpt(line->Fd) < 0
+      || ptsname_r(line->Fd, line->Path, sizeof(line->Path)) != 0)
+  {
+    return -1;
+  }
+  slave = open(line->Path, O_RDWR | O_NOCTTY);
+  if (slave < 0 || tcgetattr(slave, &mode) < 0)
+  {
+    return -1;
+  }
+  cfmakeraw(&mode);
+  tcsetattr(slave, TCSANOW, &mode);
+  close(slave);
+  return 0;
+}
+
+static pid_t StartAggregator(const char *program, const char *directory, int threads,
+                             LineObj *lines, int count)
+{
+  char *arguments[256 + 8];
+  char option[16];
+  pid_t child;
+  int n = 0;
+  int i;
+
+  arguments[n++] = (char *)program;
+  arguments[n++] = "-d";
+  arguments[n++] = (char *)directory;
+  if (threads > 0)
+  {
+    snprintf(option, sizeof(option), "%d", threads);
+    arguments[n++] = "-t";
+    arguments[n++] = option;
+  }
+  for (i = 0; i < count; i++)
+  {
+    arguments[n++] = lines[i].Path;
+  }
+  arguments[n] = NULL;
+
+  child = fork();
+  if (child == 0)
+  {
+    for (i = 0; i < count; i++)
+    {
+      close(lines[i].Fd);
+    }
+    execv(program, arguments);
+    perror(program);
+    _exit(127);
+  }
+  return child;
+}
+
+// The aggregator sets the magic last, once the header is complete
+static FleetHeaderObj *WaitRing(const char *directory, int index)
+{
+  FleetHeaderObj *ring;
+  struct stat status;
+  char path[4096];
+  int tries;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/fleet-%03d.ring", directory, index);
+  for (tries = 0; tries < 500; tries++, usleep(10000))
+  {
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+      continue;
+    }
+    if (fstat(fd, &status) < 0 || (size_t)status.st_size < sizeof(FleetHeaderObj))
+    {
+      close(fd);
+      continue;
+    }
+    ring = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED)
+    {
+      return NULL;
+    }
+    if (((volatile FleetHeaderObj *)ring)->Magic == FLEET_MAGIC)
+    {
+      return ring;
+    }
+    munmap(ring, (size_t)status.st_size);
+  }
+  return NULL;
+}
+
+static uint64_t Ingested(FleetHeaderObj **rings, int count, uint64_t *bad)
+{
+  uint64_t records = 0;
+  int i;
+
+  *bad = 0;
+  for (i = 0; i < count; i++)
+  {
+    records += atomic_load_explicit(&rings[i]->Head, memory_order_acquire);
+    *bad += ((volatile FleetHeaderObj *)rings[i])->BadFrames;
+  }
+  return records;
+}
+
+// A car record the way TelemetryFlush builds it, a few fields changing each
+// step, framed with the controller's own CobsEncode and Crc16
+static int Encode(uint8_t id, uint8_t sequence, uint32_t step, uint8_t *frame)
+{
+  uint8_t record[TELEMETRY_RECORD];
+  uint16_t crc;
+  int size = 0;
+  int length;
+
+  record[size++] = sequence;
+  record[size++] = (uint8_t)('a' + (id + step) % ELEVATORS);
+  record[size++] = TELEMETRY_FLOOR | TELEMETRY_STOPS | ((step & 1) ? TELEMETRY_DOOR : 0);
+  record[size++] = (uint8_t)(step % FLOORS);
+  if (step & 1)
+    record[size++] = (step & 2) ? OPEN : CLOSED;
+  record[size++] = (uint8_t)(step >> 4);
+  record[size++] = 0; // upper stops, a zero to be stuffed
+  crc = Crc16(record, size);
+  record[size++] = (uint8_t)crc;
+  record[size++] = (uint8_t)(crc >> 8);
+
+  length = CobsEncode(record, size, frame);
+  frame[length++] = TELEMETRY_DELIMITER;
+  return length;
+}
+
+// Batches of frames, paced to LOADTEST_BAUD unless flooding. A write blocks
+// while the pty is full, so the aggregator falling behind shows as a lower
+// offered rate, never as loss
+static void *Writer(void *argument)
+{
+  LineObj *line = argument;
+  uint8_t buffer[LOADTEST_BATCH * TELEMETRY_FRAME];
+  double start = Now();
+  double elapsed;
+  uint32_t step = 0;
+  ssize_t written;
+  int size;
+  int done;
+  int i;
+
+  while ((elapsed = Now() - start) < seconds)
+  {
+    if (!flood && line->Bytes * 10.0 / LOADTEST_BAUD > elapsed)
+    {
+      usleep((useconds_t)((line->Bytes * 10.0 / LOADTEST_BAUD - elapsed) * 1e6));
+      continue;
+    }
+    size = 0;
+    for (i = 0; i < LOADTEST_BATCH; i++, step++)
+    {
+      size += Encode(line->Id, (uint8_t)step, step, &buffer[size]);
+    }
+    for (done = 0; done < size; done += (int)written)
+    {
+      written = write(line->Fd, &buffer[done], (size_t)(size - done));
+      if (written <= 0)
+      {
+        return NULL;
+      }
+    }
+    line->Frames += LOADTEST_BATCH;
+    line->Bytes += (uint64_t)size;
+  }
+  return NULL;
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,458 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <libgen.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "misc.h"
+
+#include "building.h"
+
+#define MONTECARLO_CONFIGS 32   // controller libraries at most
+#define MONTECARLO_WORKERS 256  // worker processes at most
+#define MONTECARLO_RUNS 32      // building-days per configuration by default
+#define MONTECARLO_HOURS 24     // simulated hours of a building-day
+#define MONTECARLO_ARRIVALS 2.0 // passengers per minute
+#define MONTECARLO_SEED 1       // seed of the first run, the next ones count up
+
+typedef struct {                // one configuration data type
+  char Name[64];
+  const char *Path;             // controller library
+} ConfigObj;
+
+typedef struct {                // outcome of one building-day data type
+  bool Done;
+  uint32_t Served;
+  uint32_t Unserved;
+  double Wait;                  // s, average
+  double P95;                   // s
+  double Max;                   // s
+  double Trip;                  // s, average
+  double Energy;                // kJ
+} ResultObj;
+
+typedef struct {                // runs still owned by one worker data type
+  _Atomic uint64_t Range;       // next run in the low half, end in the high half
+  uint32_t Steals;              // ranges this worker took from others
+  uint32_t Runs;                // runs it did
+  char Pad[48];                 // one cache line per worker
+} DequeObj;
+
+typedef struct {                // pool shared by the workers data type
+  DequeObj Deques[MONTECARLO_WORKERS];
+  ResultObj Results[];          // indexed by run
+} PoolObj;
+
+typedef struct {                // controller library entry points data type
+  void (*Defaults)(BuildingConfigObj *config);
+  void (*Init)(BuildingObj *building, const BuildingConfigObj *config);
+  void (*Run)(BuildingObj *building, uint32_t until, bool (*done)(const BuildingObj *building));
+  void (*Finish)(BuildingObj *building);
+  uint32_t (*Percentile)(const BuildingStatsObj *stats, double share);
+  double (*Energy)(const BuildingObj *building);
+} LibraryObj;
+
+typedef struct {                // mean and confidence interval data type
+  double Mean;
+  double Half;                  // half width of the 95 % interval
+} EstimateObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Worker(int index);
+static bool Take(DequeObj *deque, uint32_t *run);
+static bool Steal(int index);
+static void Simulate(uint32_t run);
+static EstimateObj Estimate(int config, size_t field);
+static void Report(double seconds);
+static double Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static ConfigObj configs[MONTECARLO_CONFIGS];
+static int configCount;
+static int workers;
+static uint32_t runsPerConfig = MONTECARLO_RUNS;
+static uint32_t runCount;
+static uint32_t hours = MONTECARLO_HOURS;
+static double arrivals = MONTECARLO_ARRIVALS;
+static uint32_t seed = MONTECARLO_SEED;
+static PoolObj *pool;
+static BuildingObj building;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Monte-Carlo comparison of controller builds. Each library is main.c built
+// with one set of -D tuning parameters, the event loop or RTX, together with
+// the host target and the building model (make montecarlo builds a few). Every
+// configuration runs the same seeds, so the passengers are the same from one
+// to the next, and every run is a building-day in a fresh child that loads
+// its library there, the controller keeping its state in globals. The runs
+// are spread over -j worker processes, one per core by default: each starts
+// with an even share of the run indices and, once out of work, steals half
+// of the remaining range of another worker. The table gives the mean of
+// each metric over the runs with its 95 % confidence interval
+int main(int argc, char **argv)
+{
+  size_t size;
+  pid_t pids[MONTECARLO_WORKERS];
+  double start;
+  uint32_t share;
+  int option;
+  int i;
+
+  workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  while ((option = getopt(argc, argv, "j:n:H:a:s:")) != -1)
+  {
+    if (option == 'j')
+      workers = atoi(optarg);
+    else if (option == 'n')
+      runsPerConfig = (uint32_t)atoi(optarg);
+    else if (option == 'H')
+      hours = (uint32_t)atoi(optarg);
+    else if (option == 'a')
+      arrivals = atof(optarg);
+    else if (option == 's')
+      seed = (uint32_t)atoi(optarg);
+    else
+      break;
+  }
+  if (option != -1 || optind >= argc || argc - optind > MONTECARLO_CONFIGS || runsPerConfig < 2 || !hours)
+  {
+    fprintf(stderr, "usage: %s [-j workers] [-n runs per config] [-H hours a day] [-a arrivals/min]\n"
+                    "          [-s first seed] controller.so...\n", argv[0]);
+    return 2;
+  }
+  if (workers < 1)
+    workers = 1;
+  if (workers > MONTECARLO_WORKERS)
+    workers = MONTECARLO_WORKERS;
+
+  for (i = optind; i < argc; i++)
+  {
+    ConfigObj *config = &configs[configCount++];
+    char path[256];
+    char *name;
+
+    config->Path = argv[i];
+    snprintf(path, sizeof(path), "%s", argv[i]);
+    name = basename(path);
+    if (strncmp(name, "controller-", 11) == 0)
+    {
+      name += 11;
+    }
+    snprintf(config->Name, sizeof(config->Name), "%s", name);
+    if (strrchr(config->Name, '.'))
+    {
+      *strrchr(config->Name, '.') = 0;
+    }
+  }
+
+  // Run i is configuration i % configCount with seed i / configCount, so
+  // every share holds all the configurations
+  runCount = runsPerConfig * (uint32_t)configCount;
+  size = sizeof(PoolObj) + runCount * sizeof(ResultObj);
+  pool = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (pool == MAP_FAILED)
+  {
+    perror("mmap");
+    return 1;
+  }
+  memset(pool, 0, size);
+  share = (runCount + (uint32_t)workers - 1) / (uint32_t)workers;
+  for (i = 0; i < workers; i++)
+  {
+    uint64_t first = (uint64_t)i * share < runCount ? (uint64_t)i * share : runCount;
+    uint64_t end = first + share < runCount ? first + share : runCount;
+
+    atomic_init(&pool->Deques[i].Range, end << 32 | first);
+  }
+
+  start = Now();
+  for (i = 0; i < workers; i++)
+  {
+    if ((pids[i] = fork()) == 0)
+    {
+      Worker(i);
+      _exit(0);
+    }
+  }
+  for (i = 0; i < workers; i++)
+  {
+    waitpid(pids[i], NULL, 0);
+  }
+  Report(Now() - start);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Pool Functions
+ *---------------------------------------------------------------------------*/
+
+// Own runs from the front, then steal until no worker has any left
+static void Worker(int index)
+{
+  DequeObj *deque = &pool->Deques[index];
+  uint32_t run;
+
+  do
+  {
+    while (Take(deque, &run))
+    {
+      Simulate(run);
+      deque->Runs++;
+    }
+  } while (Steal(index));
+}
+
+static bool Take(DequeObj *deque, uint32_t *run)
+{
+  uint64_t range = atomic_load(&deque->Range);
+  uint32_t next;
+  uint32_t end;
+
+  do
+  {
+    next = (uint32_t)range;
+    end = (uint32_t)(range >> 32);
+    if (next >= end)
+    {
+      return false;
+    }
+  } while (!atomic_compare_exchange_weak(&deque->Range, &range, (uint64_t)end << 32 | (next + 1)));
+
+  *run = next;
+  return true;
+}
+
+// Take the back half of the largest range left. Only the owner moves the
+// front and only thieves the back, both through the same word, so a run is
+// never done twice
+static bool Steal(int index)
+{
+  DequeObj *victim;
+  uint64_t range;
+  uint32_t next;
+  uint32_t end;
+  uint32_t middle;
+  uint32_t most;
+  int best;
+  int i;
+
+  while (true)
+  {
+    best = -1;
+    most = 0;
+    for (i = 0; i < workers; i++)
+    {
+      range = atomic_load(&pool->Deques[i].Range);
+      next = (uint32_t)range;
+      end = (uint32_t)(range >> 32);
+      if (i != index && next < end && end - next > most)
+      {
+        most = end - next;
+        best = i;
+      }
+    }
+    if (best < 0)
+    {
+      return false;
+    }
+
+    victim = &pool->Deques[best];
+    range = atomic_load(&victim->Range);
+    next = (uint32_t)range;
+    end = (uint32_t)(range >> 32);
+    if (next >= end)
+    {
+      continue;
+    }
+    middle = next + (end - next) / 2;
+    if (atomic_compare_exchange_strong(&victim->Range, &range, (uint64_t)middle << 32 | next))
+    {
+      atomic_store(&pool->Deques[index].Range, (uint64_t)end << 32 | middle);
+      pool->Deques[index].Steals++;
+      return true;
+    }
+  }
+}
+
+// A fresh child loads the library, so the controller starts from its reset
+// state, and leaves the outcome in the shared results
+static void Simulate(uint32_t run)
+{
+  const ConfigObj *config = &configs[run % (uint32_t)configCount];
+  ResultObj *result = &pool->Results[run];
+  BuildingConfigObj settings;
+  LibraryObj library;
+  void *handle;
+  pid_t pid;
+
+  if ((pid = fork()) != 0)
+  {
+    if (pid > 0)
+    {
+      waitpid(pid, NULL, 0);
+    }
+    return;
+  }
+
+  if ((handle = dlopen(config->Path, RTLD_NOW | RTLD_LOCAL)) == NULL)
+  {
+    fprintf(stderr, "%s\n", dlerror());
+    _exit(1);
+  }
+  *(void **)&library.Defaults = dlsym(handle, "BuildingDefaults");
+  *(void **)&library.Init = dlsym(handle, "BuildingInit");
+  *(void **)&library.Run = dlsym(handle, "HarnessRun");
+  *(void **)&library.Finish = dlsym(handle, "BuildingFinish");
+  *(void **)&library.Percentile = dlsym(handle, "BuildingPercentile");
+  *(void **)&library.Energy = dlsym(handle, "BuildingEnergy");
+  if (!library.Defaults || !library.Init || !library.Run || !library.Finish || !library.Percentile
+      || !library.Energy)
+  {
+    fprintf(stderr, "%s: not a controller library\n", config->Path);
+    _exit(1);
+  }
+
+  library.Defaults(&settings);
+  settings.Arrivals = arrivals;
+  settings.Seed = seed + run / (uint32_t)configCount;
+  library.Init(&building, &settings);
+  library.Run(&building, hours * 3600000U, NULL);
+  library.Finish(&building);
+
+  result->Served = building.Stats.Served;
+  result->Unserved = building.Stats.Unserved;
+  result->Wait = building.Stats.Served ? building.Stats.WaitTotal / 1000.0 / building.Stats.Served : 0;
+  result->Trip = building.Stats.Served ? building.Stats.TripTotal / 1000.0 / building.Stats.Served : 0;
+  result->P95 = library.Percentile(&building.Stats, 0.95) / 1000.0;
+  result->Max = building.Stats.WaitMax / 1000.0;
+  result->Energy = library.Energy(&building);
+  result->Done = true;
+  _exit(0);
+}
+
+/*----------------------------------------------------------------------------
+ *      Report Functions
+ *---------------------------------------------------------------------------*/
+
+// Student's t for 95 % two-sided, by degrees of freedom, normal past 30
+static EstimateObj Estimate(int config, size_t field)
+{
+  static const double t[31] = {0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  EstimateObj estimate = {0, 0};
+  double sum = 0;
+  double squares = 0;
+  double value;
+  uint32_t n = 0;
+  uint32_t run;
+
+  for (run = (uint32_t)config; run < runCount; run += (uint32_t)configCount)
+  {
+    if (!pool->Results[run].Done)
+    {
+      continue;
+    }
+    value = *(const double *)((const char *)&pool->Results[run] + field);
+    sum += value;
+    squares += value * value;
+    n++;
+  }
+  if (n == 0)
+  {
+    return estimate;
+  }
+  estimate.Mean = sum / n;
+  if (n > 1)
+  {
+    estimate.Half = (n - 1 <= 30 ? t[n - 1] : 1.960)
+                    * sqrt(fmax(squares - sum * sum / n, 0) / (n - 1) / n);
+  }
+  return estimate;
+}
+
+static void Report(double seconds)
+{
+  static const struct {
+    const char *Name;
+    size_t Field;
+  } columns[] = {
+    {"wait s", offsetof(ResultObj, Wait)},
+    {"p95 wait s", offsetof(ResultObj, P95)},
+    {"max wait s", offsetof(ResultObj, Max)},
+    {"trip s", offsetof(ResultObj, Trip)},
+    {"energy MJ", offsetof(ResultObj, Energy)},
+  };
+  uint32_t done = 0;
+  uint32_t steals = 0;
+  uint32_t run;
+  int config;
+  int i;
+
+  for (run = 0; run < runCount; run++)
+  {
+    done += pool->Results[run].Done;
+  }
+  for (i = 0; i < workers; i++)
+  {
+    steals += pool->Deques[i].Steals;
+  }
+  printf("%u building-days of %u h, %.1f arrivals/min, on %d workers in %.1f s: %.2f days/s, %u steals\n",
+         done, hours, arrivals, workers, seconds, done / seconds, steals);
+  if (done < runCount)
+  {
+    printf("%u runs failed\n", runCount - done);
+  }
+
+  printf("%-28s %5s", "configuration", "runs");
+  for (i = 0; i < (int)(sizeof(columns) / sizeof(columns[0])); i++)
+  {
+    printf(" %17s", columns[i].Name);
+  }
+  printf(" %9s\n", "unserved");
+  for (config = 0; config < configCount; config++)
+  {
+    uint32_t runs = 0;
+    uint32_t unserved = 0;
+
+    for (run = (uint32_t)config; run < runCount; run += (uint32_t)configCount)
+    {
+      runs += pool->Results[run].Done;
+      unserved += pool->Results[run].Unserved;
+    }
+    printf("%-28s %5u", configs[config].Name, runs);
+    for (i = 0; i < (int)(sizeof(columns) / sizeof(columns[0])); i++)
+    {
+      EstimateObj estimate = Estimate(config, columns[i].Field);
+      double scale = (columns[i].Field == offsetof(ResultObj, Energy)) ? 1000.0 : 1.0;
+
+      printf(" %8.1f +- %-6.1f", estimate.Mean / scale, estimate.Half / scale);
+    }
+    printf(" %9.1f\n", runs ? (double)unserved / runs : 0.0);
+  }
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
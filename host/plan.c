@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "target.h"
+#include "controller.h"
+
+#define PLAN_PASSES 200000      // re-scoring passes timed per number of calls
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static uint64_t Now(void);
+static void Scale(void);
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Times a full re-scoring pass, both plans of Reoptimize, as the number of
+// open calls grows. One car and FLOORS floors is all this controller scores,
+// so calls is the only axis
+int main()
+{
+  SetupController();
+  Scale();
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Plan Functions
+ *---------------------------------------------------------------------------*/
+
+static uint64_t Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Car at the middle floor going up, the calls spread over the other floors
+static void Scale()
+{
+  ElevatorObj car = {CENTRAL_ELEVATOR, BUSY, FLOOR_0 + FLOORS / 2, FLOOR_15, UP, CLOSED, DESTINATION_MODE, 0, {0}};
+  volatile uint32_t sink = 0;
+  uint64_t begin;
+  double ns;
+  int calls;
+  int floor;
+  int i;
+
+  printf("%6s %14s %14s\n", "calls", "ns/pass", "ns/call");
+  for (calls = 1; calls < FLOORS; calls++)
+  {
+    car.Stops = 0;
+    for (i = 0; i < calls; i++)
+    {
+      floor = (car.ActualFloor - FLOOR_0 + 1 + i * (FLOORS - 1) / calls) % FLOORS;
+      car.Stops |= (uint16_t)(1U << floor);
+      car.CallTime[floor] = 0;
+    }
+
+    begin = Now();
+    for (i = 0; i < PLAN_PASSES; i++)
+    {
+      sink += PlanCost(&car, UP) + PlanCost(&car, DOWN);
+    }
+    ns = (double)(Now() - begin) / PLAN_PASSES;
+    printf("%6d %14.1f %14.1f\n", calls, ns, ns / calls);
+  }
+}
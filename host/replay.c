@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "inc/hw_memmap.h"
+
+#include "target.h"
+#include "controller.h"
+#include "telemetry.h"
+
+#define REPLAY_RECORDS 4096     // capture records kept from the dump
+#define REPLAY_SETTLE 2000      // ms the controller runs on after the last frame
+#define REPLAY_SHOWN 10         // mismatched frames printed
+#define REPLAY_WINDOW 8         // captured frames looked ahead to resync after a mismatch
+#define REPLAY_DUMP 8192        // bytes of UART1 output kept while recording
+
+#define BUDGET_UART 5000        // ns a UARTIntHandler entry may take with -c
+#define BUDGET_CENTRAL 10000    // ns a ThreadCentral step may take with -c
+
+#define MODEL_FLOOR 1000        // ms the model car takes per floor
+#define MODEL_DOOR 500          // ms the model door takes to close
+#define MODEL_GAP 4000          // ms between two calls of the recorded script
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Record(void *context, const uint8_t *record, int size);
+static void Transmit(uint32_t base, unsigned char byte);
+static void Idle(void);
+static void Report(void);
+static void Probe(const char *name, const ProbeObj *probe);
+static bool Budget(void);
+static void RecordTransmit(uint32_t base, unsigned char byte);
+static void RecordIdle(void);
+static void Reply(const char *frame);
+static double Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static TelemetryObj records[REPLAY_RECORDS];
+static int recordCount;
+static int nextRx;              // record fed next
+static int nextTx;              // captured frame the next sent one is checked against
+static bool realTime;
+static bool quiet;
+static bool check;
+static uint32_t startTick;
+static bool done;
+static uint32_t doneTick;       // tick the last frame was fed at
+static double doneTime;
+static int fed;
+static int sent;
+static int matched;
+static int missing;             // captured frames the controller did not send
+static int shown;
+static char txFrame[16];
+static int txSize;
+static double startTime;
+
+// Recording: a model car answers the controller while a script of calls runs,
+// each step the frames sent at once. Up-peak: a lobby call and the car calls
+// of the passengers boarding, two of them for the same floor
+static const char *script[] = {"cE00s", "cIc cIf cIc cIh", "cE00s", "cIm cIe cIm"};
+static FILE *dumpFile;
+static unsigned char dump[REPLAY_DUMP];
+static size_t dumpSize;
+static int scriptNext;
+static uint32_t lastBusy;       // tick the car last moved or closed its door
+static int modelFloor;
+static int modelDirection;      // floors per step, 0 when stopped
+static uint32_t modelStep;      // tick of the next floor report
+static uint32_t doorDone;       // tick the door finishes closing, 0 if not closing
+static uint32_t dumpTick;       // tick the dump was asked for, 0 before
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Replays a capture dump, the capture records of a DUMP_CAPTURE in the UART1
+// telemetry stream, into the controller through the same UART0 interrupt
+// path the frames first came in by. As fast as the controller takes them,
+// one frame each time it goes idle, or with -r at their original spacing in
+// controller ticks. Reports the
+// replay throughput and checks every frame the controller sends against the
+// frames captured, so two controller versions can be compared on the same
+// field traffic. With -c it fails when a probe went over its budget. With -w
+// it records a dump instead: a short script of calls against a model car,
+// then a DUMP_CAPTURE on UART1
+int main(int argc, char **argv)
+{
+  static unsigned char bytes[REPLAY_DUMP];
+  TelemetryDecoderObj decoder = {0};
+  const char *recordPath = NULL;
+  size_t size;
+  FILE *file;
+  int option;
+
+  while ((option = getopt(argc, argv, "rqcw:")) != -1)
+  {
+    if (option == 'r')
+      realTime = true;
+    else if (option == 'q')
+      quiet = true;
+    else if (option == 'c')
+      check = true;
+    else if (option == 'w')
+      recordPath = optarg;
+    else
+    {
+      fprintf(stderr, "usage: %s [-r] [-q] [-c] dump | -w dump\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (recordPath)
+  {
+    if ((dumpFile = fopen(recordPath, "wb")) == NULL)
+    {
+      perror(recordPath);
+      return 1;
+    }
+    host.Transmit = RecordTransmit;
+    host.Idle = RecordIdle;
+    ControllerMain();
+    return 0;
+  }
+
+  if (optind >= argc || (file = fopen(argv[optind], "rb")) == NULL)
+  {
+    fprintf(stderr, "usage: %s [-r] [-q] [-c] dump | -w dump\n", argv[0]);
+    return 2;
+  }
+  while ((size = fread(bytes, 1, sizeof(bytes), file)) > 0)
+  {
+    TelemetryPush(&decoder, bytes, (int)size, Record, NULL);
+  }
+  fclose(file);
+  if (recordCount == 0)
+  {
+    fprintf(stderr, "%s: no capture dump in the stream\n", argv[optind]);
+    return 1;
+  }
+  printf("%d captured frames, %llu bad telemetry frames skipped\n", recordCount,
+         (unsigned long long)decoder.BadFrames);
+
+  host.Transmit = Transmit;
+  host.Idle = Idle;
+  startTick = HostTicks();
+  startTime = Now();
+  ControllerMain();
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Replay Functions
+ *---------------------------------------------------------------------------*/
+
+// Capture records of the last dump in the stream, a new start drops the ones
+// before it. The car records around the dump are skipped
+static void Record(void *context, const uint8_t *record, int size)
+{
+  TelemetryObj telemetry;
+
+  if (!TelemetryParse(record, size, &telemetry) || telemetry.Car != TELEMETRY_CAPTURE)
+  {
+    return;
+  }
+  if (telemetry.Direction == CAPTURE_START)
+  {
+    recordCount = 0;
+  }
+  else if (recordCount < REPLAY_RECORDS)
+  {
+    records[recordCount++] = telemetry;
+  }
+}
+
+// Frames the controller sends on UART0, checked in order against the TX
+// records of the capture
+static void Transmit(uint32_t base, unsigned char byte)
+{
+  int window;
+  int i;
+
+  if (base != UART0_BASE)
+  {
+    return;
+  }
+  if (byte != END_COMMAND)
+  {
+    if (txSize < (int)sizeof(txFrame))
+    {
+      txFrame[txSize++] = (char)byte;
+    }
+    return;
+  }
+
+  sent++;
+  for (i = nextTx, window = 0; i < recordCount && window < REPLAY_WINDOW; i++)
+  {
+    if (records[i].Direction != CAPTURE_TX)
+    {
+      continue;
+    }
+    if (records[i].Size == txSize && memcmp(records[i].Command, txFrame, (size_t)txSize) == 0)
+    {
+      break;
+    }
+    window++;
+  }
+  if (i < recordCount && window < REPLAY_WINDOW)
+  {
+    // Captured frames skipped over were not sent this time
+    matched++;
+    missing += window;
+    nextTx = i + 1;
+  }
+  else if (shown++ < REPLAY_SHOWN && !quiet)
+  {
+    printf("sent %.*s at %u ms, not captured\n", txSize, txFrame, HostTicks() - startTick);
+  }
+  txSize = 0;
+}
+
+static void Idle()
+{
+  char frame[sizeof(records[0].Command) + 1];
+  uint32_t now;
+
+  HostTick(1);
+  now = HostTicks() - startTick;
+
+  while (nextRx < recordCount && records[nextRx].Direction != CAPTURE_RX)
+  {
+    nextRx++;
+  }
+  if (nextRx == recordCount)
+  {
+    if (!done)
+    {
+      done = true;
+      doneTick = now;
+      doneTime = Now();
+    }
+    if (now - doneTick >= REPLAY_SETTLE)
+    {
+      Report();
+      exit(Budget() ? 0 : 1);
+    }
+    return;
+  }
+
+  if (realTime && now < records[nextRx].Time - records[0].Time)
+  {
+    return;
+  }
+  memcpy(frame, records[nextRx].Command, (size_t)records[nextRx].Size);
+  frame[records[nextRx].Size] = END_COMMAND;
+  HostReceive(UART0_BASE, frame, records[nextRx].Size + 1);
+  nextRx++;
+  fed++;
+}
+
+// Wall time excludes the settling run after the last frame
+static void Report()
+{
+  double seconds = doneTime - startTime;
+
+  printf("%d frames replayed in %u controller ms, %.6f s: %.0f frames/s\n", fed, doneTick,
+         seconds, fed / seconds);
+  printf("%d frames sent, %d of them as captured, %d captured frames not sent\n", sent, matched, missing);
+  printf("%u calls accepted, %u stops made in %u trips, %.1f stops per trip\n", centralCalls, centralStops,
+         centralTrips, centralTrips ? (double)centralStops / centralTrips : 0.0);
+  Probe("door closed to motion", &probeCloseToMove);
+  Probe("UARTIntHandler", &probeUart);
+  Probe("ThreadCentral step", &probeCentral);
+}
+
+// Host probes count ns
+static void Probe(const char *name, const ProbeObj *probe)
+{
+  if (probe->Count)
+  {
+    printf("%-22s %8.2f us mean %8.2f us max over %u\n", name, PROFILE_MEAN(*probe) / 1e3,
+           probe->Max / 1e3, probe->Count);
+  }
+}
+
+// The worst case of each probe, not the mean: a handler over its budget once
+// is enough to miss a byte
+static bool Budget()
+{
+  bool within = PROFILE_WITHIN(probeUart, BUDGET_UART) && PROFILE_WITHIN(probeCentral, BUDGET_CENTRAL);
+
+  if (check)
+  {
+    printf("budgets %u ns UARTIntHandler, %u ns ThreadCentral step: %s\n", BUDGET_UART, BUDGET_CENTRAL,
+           within ? "met" : "EXCEEDED");
+  }
+  return within || !check;
+}
+
+/*----------------------------------------------------------------------------
+ *      Record Functions
+ *---------------------------------------------------------------------------*/
+
+// UART1 is the dump, UART0 the commands the model car acts on
+static void RecordTransmit(uint32_t base, unsigned char byte)
+{
+  if (base == UART1_BASE)
+  {
+    if (dumpSize < sizeof(dump))
+    {
+      dump[dumpSize++] = byte;
+    }
+    return;
+  }
+  if (byte != END_COMMAND)
+  {
+    if (txSize < (int)sizeof(txFrame))
+    {
+      txFrame[txSize++] = (char)byte;
+    }
+    return;
+  }
+
+  if (txSize == 2 && txFrame[1] == UP)
+  {
+    modelDirection = 1;
+    modelStep = HostTicks() + MODEL_FLOOR;
+  }
+  else if (txSize == 2 && txFrame[1] == DOWN)
+  {
+    modelDirection = -1;
+    modelStep = HostTicks() + MODEL_FLOOR;
+  }
+  else if (txSize == 2 && txFrame[1] == STOP)
+  {
+    modelDirection = 0;
+  }
+  else if (txSize == 2 && txFrame[1] == CLOSED)
+  {
+    doorDone = HostTicks() + MODEL_DOOR;
+  }
+  txSize = 0;
+}
+
+// One ms per idle: the script, the model car and finally the dump request.
+// The next step waits until the car has been still for MODEL_GAP
+static void RecordIdle()
+{
+  char frame[8];
+  uint32_t now;
+
+  HostTick(1);
+  now = HostTicks();
+  if (modelDirection || doorDone)
+  {
+    lastBusy = now;
+  }
+
+  if (doorDone && now >= doorDone)
+  {
+    doorDone = 0;
+    Reply("cF");
+  }
+  if (modelDirection && now >= modelStep)
+  {
+    modelFloor += modelDirection;
+    modelStep = now + MODEL_FLOOR;
+    snprintf(frame, sizeof(frame), "c%d", modelFloor);
+    Reply(frame);
+  }
+
+  if (scriptNext < (int)(sizeof(script) / sizeof(script[0])))
+  {
+    if (now - lastBusy >= MODEL_GAP)
+    {
+      Reply(script[scriptNext++]);
+      lastBusy = now;
+    }
+    return;
+  }
+  if (!dumpTick && now - lastBusy >= MODEL_GAP)
+  {
+    dumpTick = now;
+    HostReceive(UART1_BASE, (const char[]){DUMP_CAPTURE}, 1);
+  }
+  else if (dumpTick && now - dumpTick >= REPLAY_SETTLE)
+  {
+    fwrite(dump, 1, dumpSize, dumpFile);
+    fclose(dumpFile);
+    printf("%zu dump bytes written, car at floor %d\n", dumpSize, modelFloor);
+    exit(0);
+  }
+}
+
+// Space separated frames, each with its end of command
+static void Reply(const char *frames)
+{
+  char line[64];
+  int size;
+
+  for (size = 0; frames[size] && size < (int)sizeof(line) - 1; size++)
+  {
+    line[size] = (frames[size] == ' ') ? END_COMMAND : frames[size];
+  }
+  line[size] = END_COMMAND;
+  HostReceive(UART0_BASE, line, size + 1);
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
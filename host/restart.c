@@ -0,0 +1,251 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "target.h"
+#include "controller.h"
+#include "building.h"
+#include "harness.h"
+
+#define RESTART_EEPROM "build/restart.eeprom"
+#define RESTART_PARKED 8        // floor the car is left at before the reboot
+#define RESTART_STALE 3         // floor it is moved to behind the controller's back
+#define RESTART_RAISED 12       // or moved up past the parked floor
+#define RESTART_CALLER 12       // floor of the passenger calling at boot, going to the ground floor
+#define RESTART_BELOW 5         // the caller's floor with the car raised, below the stored floor
+#define RESTART_SETTLE 1000     // ms the first run goes on once its passenger is out
+#define RESTART_LIMIT 300000    // ms either run may take
+
+typedef enum {                  // restart phase data type
+  PHASE_COLD,                   // blank EEPROM, car at RESTART_PARKED
+  PHASE_WARM,                   // parked with the door open, then rebooted
+  PHASE_MIDTRIP,                // rebooted between floors, door closed
+  PHASE_STALE,                  // parked record, car since moved to RESTART_STALE
+  PHASE_RAISED,                 // parked record, car since moved to RESTART_RAISED
+  PHASES
+} PhaseType;
+
+typedef struct {                // result of one boot data type
+  bool Served;
+  uint32_t Wait;                // ms from boot to the caller boarding
+  uint32_t Trip;                // ms from boot to the caller out at the exit
+  uint32_t Resets;              // INIT_ELEVATOR frames the car got
+  uint32_t Writes;              // EEPROM records written before the reboot
+  uint32_t Outages;             // times the controller took the car out of service
+} ResultObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static bool Prepare(PhaseType phase, CarModelObj *car, uint32_t *writes);
+static bool Boot(const CarModelObj *car, ResultObj *result);
+static bool Parked(const BuildingObj *building);
+static bool MidTrip(const BuildingObj *building);
+static bool Served(const BuildingObj *building);
+static bool Child(void *data, size_t size, void (*run)(void *data));
+static void RunPrepare(void *data);
+static void RunBoot(void *data);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static const char *const names[PHASES] = {"cold", "warm", "mid-trip", "stale", "raised"};
+static BuildingObj building;
+static BuildingConfigObj config;
+static PhaseType runPhase;
+static uint32_t servedAt;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Time from power-on to service with the car state in the file-backed
+// EEPROM. Each phase runs the controller twice, each run in its own child
+// because the controller cannot be reset in process: the first run leaves
+// the car and the EEPROM the way the phase needs, the second boots from
+// them with a passenger already waiting at RESTART_CALLER, RESTART_BELOW
+// for the raised phase. A warm start answers at once, a cold one re-homes
+// the car first
+int main(int argc, char **argv)
+{
+  CarModelObj car;
+  ResultObj result;
+  uint32_t writes;
+  int option;
+  int phase;
+
+  hostEepromFile = RESTART_EEPROM;
+  while ((option = getopt(argc, argv, "e:")) != -1)
+  {
+    if (option == 'e')
+      hostEepromFile = optarg;
+    else
+    {
+      fprintf(stderr, "usage: %s [-e eeprom file]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  BuildingDefaults(&config);
+  config.Arrivals = 0;
+
+  printf("%-10s %6s %8s %12s %12s %8s\n", "phase", "start", "records", "boarded s", "delivered s", "outages");
+  for (phase = 0; phase < PHASES; phase++)
+  {
+    if (!Prepare((PhaseType)phase, &car, &writes) || !Boot(&car, &result))
+    {
+      fprintf(stderr, "%s: run failed\n", names[phase]);
+      return 1;
+    }
+    if (!result.Served)
+    {
+      printf("%-10s %6s %8u %12s %12s %8u\n", names[phase], result.Resets ? "cold" : "warm", writes, "-", "-",
+             result.Outages);
+      continue;
+    }
+    printf("%-10s %6s %8u %12.2f %12.2f %8u\n", names[phase], result.Resets ? "cold" : "warm", writes,
+           result.Wait / 1000.0, result.Trip / 1000.0, result.Outages);
+  }
+  unlink(hostEepromFile);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Phase Functions
+ *---------------------------------------------------------------------------*/
+
+// First run from a blank EEPROM: none for the cold phase, a trip to
+// RESTART_PARKED otherwise, cut short for the mid-trip one. The car is left
+// as power loss leaves it, stopped with its door where it was
+static bool Prepare(PhaseType phase, CarModelObj *car, uint32_t *writes)
+{
+  struct {
+    CarModelObj Car;
+    uint32_t Writes;
+  } prepared;
+
+  unlink(hostEepromFile);
+  memset(&prepared, 0, sizeof(prepared));
+  runPhase = phase;
+  if (phase == PHASE_COLD)
+  {
+    prepared.Car.Door = OPEN;
+    prepared.Car.Position = RESTART_PARKED * BUILDING_FLOOR_HEIGHT;
+  }
+  else
+  {
+    if (!Child(&prepared, sizeof(prepared), RunPrepare))
+    {
+      return false;
+    }
+  }
+
+  *car = prepared.Car;
+  car->Motion = 0;
+  car->Homing = false;
+  car->Held = 0;
+  car->DoorTarget = 0;
+  car->DoorQueued = 0;
+  car->Resets = 0;
+  if (phase == PHASE_STALE)
+  {
+    car->Position = RESTART_STALE * BUILDING_FLOOR_HEIGHT;
+  }
+  else if (phase == PHASE_RAISED)
+  {
+    car->Position = RESTART_RAISED * BUILDING_FLOOR_HEIGHT;
+  }
+  *writes = prepared.Writes;
+  return true;
+}
+
+static bool Boot(const CarModelObj *car, ResultObj *result)
+{
+  memset(result, 0, sizeof(*result));
+  building.Cars[0] = *car;
+  return Child(result, sizeof(*result), RunBoot);
+}
+
+static void RunPrepare(void *data)
+{
+  struct {
+    CarModelObj Car;
+    uint32_t Writes;
+  } *prepared = data;
+
+  BuildingInit(&building, &config);
+  BuildingArrive(&building, 0, 0, RESTART_PARKED);
+  HarnessRun(&building, RESTART_LIMIT, runPhase == PHASE_MIDTRIP ? MidTrip : Parked);
+  prepared->Car = building.Cars[0];
+  prepared->Writes = hostEepromWrites;
+}
+
+static void RunBoot(void *data)
+{
+  ResultObj *result = data;
+  CarModelObj car = building.Cars[0];
+
+  BuildingInit(&building, &config);
+  building.Cars[0] = car;
+  BuildingArrive(&building, 0, runPhase == PHASE_RAISED ? RESTART_BELOW : RESTART_CALLER, 0);
+  HarnessRun(&building, RESTART_LIMIT, Served);
+  result->Served = building.Stats.Served > 0;
+  result->Wait = (uint32_t)building.Stats.WaitTotal;
+  result->Trip = (uint32_t)building.Stats.TripTotal;
+  result->Resets = building.Cars[0].Resets;
+  result->Outages = outages[0];
+}
+
+// Passenger out and the controller's last state saved
+static bool Parked(const BuildingObj *building)
+{
+  if (building->Stats.Served && !servedAt)
+  {
+    servedAt = building->Now;
+  }
+  return servedAt && building->Now - servedAt >= RESTART_SETTLE;
+}
+
+// Half way between two floors on the way up
+static bool MidTrip(const BuildingObj *building)
+{
+  const CarModelObj *car = &building->Cars[0];
+
+  return car->Motion > 0 && car->Position >= (RESTART_PARKED / 2) * BUILDING_FLOOR_HEIGHT + BUILDING_FLOOR_HEIGHT / 2;
+}
+
+static bool Served(const BuildingObj *building)
+{
+  return building->Stats.Served > 0;
+}
+
+// run in a child of its own, its result back through a pipe
+static bool Child(void *data, size_t size, void (*run)(void *data))
+{
+  int fds[2];
+  int status;
+  pid_t pid;
+  bool ok;
+
+  if (pipe(fds) || (pid = fork()) < 0)
+  {
+    return false;
+  }
+  if (pid == 0)
+  {
+    close(fds[0]);
+    run(data);
+    _exit(write(fds[1], data, size) == (ssize_t)size ? 0 : 1);
+  }
+  close(fds[1]);
+  ok = read(fds[0], data, size) == (ssize_t)size;
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
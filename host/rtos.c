@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "cmsis_os2.h"
+
+#include "target.h"
+
+#define RTOS_THREADS 8          // threads main.c may create
+#define RTOS_STACK 65536        // bytes of stack per thread
+#define RTOS_TIMERS 4           // timers main.c may create
+
+typedef struct {                // message queue data type
+  uint32_t Count;
+  uint32_t Size;
+  uint32_t Head;
+  uint32_t Used;
+  char *Data;
+} QueueObj;
+
+typedef struct {                // thread data type
+  ucontext_t Context;
+  osThreadFunc_t Func;
+  void *Argument;
+  osPriority_t Priority;
+  bool Blocked;
+  bool Forever;                 // no timeout on the wait
+  uint32_t Until;               // tick the wait times out at
+  QueueObj *Empty;              // waiting for a message on this queue
+  QueueObj *Full;               // waiting for room on this queue
+} ThreadObj;
+
+typedef struct {                // timer data type
+  osTimerFunc_t Func;
+  void *Argument;
+  osTimerType_t Type;
+  uint32_t Period;
+  uint32_t Remaining;           // ms to the next run, 0 when stopped
+} TimerObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+void RtosTick(void);
+static void Start(void);
+static bool Ready(ThreadObj *thread);
+static bool Wait(QueueObj *empty, QueueObj *full, uint32_t timeout);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static osKernelState_t kernelState = osKernelInactive;
+static ThreadObj threads[RTOS_THREADS];
+static int threadCount;
+static ThreadObj *running;       // NULL outside the threads: the tools and the ISRs
+static ucontext_t scheduler;
+static TimerObj timers[RTOS_TIMERS];
+static int timerCount;
+
+/*----------------------------------------------------------------------------
+ *      Kernel Functions
+ *---------------------------------------------------------------------------*/
+
+osStatus_t osKernelInitialize()
+{
+  kernelState = osKernelReady;
+  return osOK;
+}
+
+osKernelState_t osKernelGetState()
+{
+  return kernelState;
+}
+
+// Cooperative: the highest priority thread that can run goes on until it
+// blocks on a queue or a delay, a switch RTX would make earlier on an
+// interrupt only happens at that point. With every thread blocked the
+// target idles, host.Idle or one tick. Returns only when there is no thread
+osStatus_t osKernelStart()
+{
+  ThreadObj *next;
+  int i;
+
+  kernelState = osKernelRunning;
+  while (threadCount)
+  {
+    next = NULL;
+    for (i = 0; i < threadCount; i++)
+    {
+      if (Ready(&threads[i]) && (!next || threads[i].Priority > next->Priority))
+      {
+        next = &threads[i];
+      }
+    }
+
+    if (next)
+    {
+      running = next;
+      swapcontext(&scheduler, &next->Context);
+      running = NULL;
+    }
+    else if (host.Idle)
+    {
+      host.Idle();
+    }
+    else
+    {
+      HostTick(1);
+    }
+  }
+  return osOK;
+}
+
+uint32_t osKernelGetTickCount()
+{
+  return HostTicks();
+}
+
+// The thread is set up through the array, not a local pointer: getcontext
+// returns twice, like setjmp
+osThreadId_t osThreadNew(osThreadFunc_t func, void *argument, const osThreadAttr_t *attr)
+{
+  if (threadCount == RTOS_THREADS)
+  {
+    return NULL;
+  }
+  getcontext(&threads[threadCount].Context);
+  threads[threadCount].Func = func;
+  threads[threadCount].Argument = argument;
+  threads[threadCount].Priority = (attr && attr->priority) ? attr->priority : osPriorityNormal;
+  threads[threadCount].Context.uc_stack.ss_sp = malloc(RTOS_STACK);
+  threads[threadCount].Context.uc_stack.ss_size = RTOS_STACK;
+  threads[threadCount].Context.uc_link = NULL;
+  if (!threads[threadCount].Context.uc_stack.ss_sp)
+  {
+    return NULL;
+  }
+  makecontext(&threads[threadCount].Context, Start, 0);
+  return &threads[threadCount++];
+}
+
+// Outside the threads a delay just lets the ticks pass
+osStatus_t osDelay(uint32_t ticks)
+{
+  if (!running)
+  {
+    HostTick(ticks);
+    return osOK;
+  }
+  Wait(NULL, NULL, ticks);
+  return osOK;
+}
+
+static void Start()
+{
+  running->Func(running->Argument);
+}
+
+static bool Ready(ThreadObj *thread)
+{
+  if (!thread->Blocked)
+  {
+    return true;
+  }
+  if ((thread->Empty && thread->Empty->Used) ||
+      (thread->Full && thread->Full->Used < thread->Full->Count) ||
+      (!thread->Forever && (int32_t)(HostTicks() - thread->Until) >= 0))
+  {
+    thread->Blocked = false;
+    return true;
+  }
+  return false;
+}
+
+// Back to the scheduler until the queue condition holds or the timeout runs
+// out, false on the timeout
+static bool Wait(QueueObj *empty, QueueObj *full, uint32_t timeout)
+{
+  ThreadObj *thread = running;
+
+  thread->Blocked = true;
+  thread->Forever = (timeout == osWaitForever);
+  thread->Until = HostTicks() + timeout;
+  thread->Empty = empty;
+  thread->Full = full;
+  swapcontext(&thread->Context, &scheduler);
+  thread->Empty = NULL;
+  thread->Full = NULL;
+  return !(empty && !empty->Used) && !(full && full->Used == full->Count);
+}
+
+/*----------------------------------------------------------------------------
+ *      Timer Functions
+ *---------------------------------------------------------------------------*/
+
+osTimerId_t osTimerNew(osTimerFunc_t func, osTimerType_t type, void *argument, const void *attr)
+{
+  TimerObj *timer;
+
+  if (timerCount == RTOS_TIMERS)
+  {
+    return NULL;
+  }
+  timer = &timers[timerCount++];
+  timer->Func = func;
+  timer->Argument = argument;
+  timer->Type = type;
+  return timer;
+}
+
+osStatus_t osTimerStart(osTimerId_t timer, uint32_t ticks)
+{
+  TimerObj *object = timer;
+
+  if (!object || !ticks)
+  {
+    return osErrorParameter;
+  }
+  object->Period = ticks;
+  object->Remaining = ticks;
+  return osOK;
+}
+
+// Called by HostTick every ms, runs the timers that expire. On the target
+// they run in the timer thread above the others, here outside the threads,
+// so a callback must not wait on a queue either way
+void RtosTick()
+{
+  int i;
+
+  for (i = 0; i < timerCount; i++)
+  {
+    if (timers[i].Remaining && --timers[i].Remaining == 0)
+    {
+      timers[i].Remaining = (timers[i].Type == osTimerPeriodic) ? timers[i].Period : 0;
+      timers[i].Func(timers[i].Argument);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Message Queue Functions
+ *---------------------------------------------------------------------------*/
+
+osMessageQueueId_t osMessageQueueNew(uint32_t count, uint32_t size, const void *attr)
+{
+  QueueObj *queue = calloc(1, sizeof(QueueObj));
+
+  if (!queue || !(queue->Data = malloc((size_t)count * size)))
+  {
+    free(queue);
+    return NULL;
+  }
+  queue->Count = count;
+  queue->Size = size;
+  return queue;
+}
+
+// A thread waits up to the timeout for room; the tools and the ISRs never
+// wait, a full queue is a resource error for them
+osStatus_t osMessageQueuePut(osMessageQueueId_t queue, const void *msg, uint8_t priority, uint32_t timeout)
+{
+  QueueObj *object = queue;
+
+  if (!object)
+  {
+    return osErrorParameter;
+  }
+  if (object->Used == object->Count && (!running || !timeout || !Wait(NULL, object, timeout)))
+  {
+    return timeout ? osErrorTimeout : osErrorResource;
+  }
+  memcpy(object->Data + ((object->Head + object->Used) % object->Count) * object->Size, msg, object->Size);
+  object->Used++;
+  return osOK;
+}
+
+osStatus_t osMessageQueueGet(osMessageQueueId_t queue, void *msg, uint8_t *priority, uint32_t timeout)
+{
+  QueueObj *object = queue;
+
+  if (!object)
+  {
+    return osErrorParameter;
+  }
+  if (!object->Used && (!running || !timeout || !Wait(object, NULL, timeout)))
+  {
+    return timeout ? osErrorTimeout : osErrorResource;
+  }
+  memcpy(msg, object->Data + object->Head * object->Size, object->Size);
+  object->Head = (object->Head + 1) % object->Count;
+  object->Used--;
+  if (priority)
+  {
+    *priority = 0;
+  }
+  return osOK;
+}
+
+uint32_t osMessageQueueGetCount(osMessageQueueId_t queue)
+{
+  QueueObj *object = queue;
+
+  return object ? object->Used : 0;
+}
+
+uint32_t osMessageQueueGetSpace(osMessageQueueId_t queue)
+{
+  QueueObj *object = queue;
+
+  return object ? object->Count - object->Used : 0;
+}
+
+osStatus_t osMessageQueueReset(osMessageQueueId_t queue)
+{
+  QueueObj *object = queue;
+
+  if (!object)
+  {
+    return osErrorParameter;
+  }
+  object->Head = 0;
+  object->Used = 0;
+  return osOK;
+}
@@ -0,0 +1,240 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "misc.h"
+
+#include "building.h"
+
+#define SIM_ARGS 16             // arguments of the controller command
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static int OpenPty(char *slave, size_t size);
+static void Send(void *context, const char *frame, int size);
+static void Stop(int signal);
+static double Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static BuildingObj building;
+static volatile sig_atomic_t stopping;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Stand-in for the course simulator on a pseudo terminal: the building model
+// answers the frames a controller sends on the pty and sends it floor
+// reports, acks and the passengers' button presses. Time runs at real time
+// or -x times faster; the controller on the other end has to keep the same
+// pace (ctlrun -x). With a command after the options the simulator starts it
+// with the pty path as its last argument and stops when it exits, otherwise
+// it prints the path and runs until -s seconds or SIGINT. The passenger
+// figures are printed at the end
+int main(int argc, char **argv)
+{
+  BuildingConfigObj config;
+  char slave[64];
+  char frame[BUILDING_FRAME];
+  char bytes[256];
+  char *args[SIM_ARGS + 2];
+  double speed = 1;
+  double start;
+  uint32_t seconds = 0;
+  uint32_t now;
+  pid_t child = 0;
+  struct pollfd poller;
+  ssize_t size;
+  int frameSize = 0;
+  int master;
+  int option;
+  int i;
+
+  BuildingDefaults(&config);
+  while ((option = getopt(argc, argv, "+x:s:a:l:c:o:r:f:F:e:")) != -1)
+  {
+    if (option == 'x')
+      speed = atof(optarg);
+    else if (option == 's')
+      seconds = (uint32_t)atoi(optarg);
+    else if (option == 'a')
+      config.Arrivals = atof(optarg);
+    else if (option == 'l')
+      config.Latency = (uint32_t)atoi(optarg);
+    else if (option == 'c')
+      config.Capacity = atoi(optarg);
+    else if (option == 'o')
+      config.Reopen = atof(optarg);
+    else if (option == 'r')
+      config.Seed = (uint32_t)atoi(optarg);
+    else if (option == 'f')
+      config.FailAt = (uint32_t)atoi(optarg) * 1000;
+    else if (option == 'F')
+      config.FailFor = (uint32_t)atoi(optarg) * 1000;
+    else if (option == 'e')
+      config.EvacuateAt = (uint32_t)atoi(optarg) * 1000;
+    else
+    {
+      fprintf(stderr, "usage: %s [-x speed] [-s seconds] [-a arrivals/min] [-l latency ms] [-c capacity]\n"
+                      "          [-o reopen share] [-r seed] [-f fail at s -F for s] [-e evacuate at s]\n"
+                      "          [command...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (speed <= 0 || argc - optind > SIM_ARGS)
+  {
+    fprintf(stderr, "%s: bad speed or too many command arguments\n", argv[0]);
+    return 2;
+  }
+
+  if ((master = OpenPty(slave, sizeof(slave))) < 0)
+  {
+    fprintf(stderr, "pty: %s\n", strerror(errno));
+    return 1;
+  }
+  signal(SIGINT, Stop);
+  signal(SIGTERM, Stop);
+
+  BuildingInit(&building, &config);
+  building.Send = Send;
+  building.Context = &master;
+
+  if (optind < argc)
+  {
+    for (i = optind; i < argc; i++)
+    {
+      args[i - optind] = argv[i];
+    }
+    args[argc - optind] = slave;
+    args[argc - optind + 1] = NULL;
+    if ((child = fork()) == 0)
+    {
+      execvp(args[0], args);
+      fprintf(stderr, "%s: %s\n", args[0], strerror(errno));
+      _exit(127);
+    }
+  }
+  else
+  {
+    printf("%s\n", slave);
+    fflush(stdout);
+  }
+
+  // The model is stepped to the scaled wall clock, waking for each frame
+  poller.fd = master;
+  poller.events = POLLIN;
+  start = Now();
+  while (!stopping)
+  {
+    now = (uint32_t)((Now() - start) * 1000 * speed);
+    if (seconds && now >= seconds * 1000)
+    {
+      break;
+    }
+    BuildingStep(&building, now);
+    if (child && waitpid(child, NULL, WNOHANG) == child)
+    {
+      child = 0;
+      break;
+    }
+
+    if (poll(&poller, 1, 1) <= 0 || !(poller.revents & POLLIN))
+    {
+      continue;
+    }
+    if ((size = read(master, bytes, sizeof(bytes))) <= 0)
+    {
+      continue;
+    }
+    for (i = 0; i < size; i++)
+    {
+      if (bytes[i] != END_COMMAND)
+      {
+        if (frameSize < BUILDING_FRAME)
+        {
+          frame[frameSize++] = bytes[i];
+        }
+        continue;
+      }
+      BuildingCommand(&building, frame, frameSize);
+      frameSize = 0;
+    }
+  }
+
+  if (child)
+  {
+    kill(child, SIGTERM);
+    waitpid(child, NULL, 0);
+  }
+  BuildingFinish(&building);
+  fprintf(stderr, "%u s simulated in %.2f s\n", building.Now / 1000, Now() - start);
+  BuildingReport(&building, stderr);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Pty Functions
+ *---------------------------------------------------------------------------*/
+
+// The slave end stays open here as well, raw, so the master does not read
+// EIO while no controller has it open
+static int OpenPty(char *slave, size_t size)
+{
+  struct termios termios;
+  int master;
+  int fd;
+
+  if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) || unlockpt(master)
+      || ptsname_r(master, slave, size))
+  {
+    return -1;
+  }
+  if ((fd = open(slave, O_RDWR | O_NOCTTY)) < 0)
+  {
+    return -1;
+  }
+  tcgetattr(fd, &termios);
+  cfmakeraw(&termios);
+  cfsetspeed(&termios, B115200);
+  tcsetattr(fd, TCSANOW, &termios);
+  return master;
+}
+
+static void Send(void *context, const char *frame, int size)
+{
+  char bytes[BUILDING_FRAME + 1];
+
+  memcpy(bytes, frame, (size_t)size);
+  bytes[size] = END_COMMAND;
+  if (write(*(int *)context, bytes, (size_t)size + 1) < 0)
+  {
+    building.ToController.Dropped++;
+  }
+}
+
+static void Stop(int signal)
+{
+  stopping = 1;
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
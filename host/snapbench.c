@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "controller.h"
+
+#define SNAPBENCH_READERS 8     // most reader threads by default
+#define SNAPBENCH_SECONDS 1     // s of publishing for each row
+#define SNAPBENCH_BATCH 16      // publishes between two clock reads
+#define SNAPBENCH_BATCHES (1 << 21) // batches kept for the percentiles
+
+typedef struct {                // reader thread data type
+  pthread_t Thread;
+  uint64_t Reads;
+  uint64_t Torn;                // snapshots whose fields disagree
+} ReaderObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Row(int readers, bool locked);
+static void Publish(ElevatorObj *elevator, bool locked);
+static void *Reader(void *argument);
+static bool Torn(const SnapshotObj *snapshot);
+static int Compare(const void *a, const void *b);
+static uint64_t Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static int seconds = SNAPBENCH_SECONDS;
+static double baseline;          // ns/publish, median of the same state with no reader
+static volatile bool running;
+static volatile bool lockedRun;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static SnapshotObj shared;       // the car state behind the mutex
+static uint64_t batches[SNAPBENCH_BATCHES];
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// ns per PublishSnapshot with 0, 1, 2, 4... reader threads spinning on
+// ReadSnapshot, then the same with the car state behind a mutex both sides
+// take, which is what the latch replaces. The latch rows should not move
+// with the readers; torn counts snapshots whose fields disagree
+int main(int argc, char **argv)
+{
+  int readers = SNAPBENCH_READERS;
+  int count;
+  int option;
+
+  while ((option = getopt(argc, argv, "t:s:")) != -1)
+  {
+    if (option == 't')
+      readers = atoi(optarg);
+    else if (option == 's')
+      seconds = atoi(optarg);
+    else
+    {
+      fprintf(stderr, "usage: %s [-t readers] [-s seconds]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (readers < 0 || seconds < 1)
+  {
+    fprintf(stderr, "%s: bad reader count or duration\n", argv[0]);
+    return 2;
+  }
+
+  printf("%d online cpus, %d s per row\n", (int)sysconf(_SC_NPROCESSORS_ONLN), seconds);
+  printf("%-6s %7s %12s %12s %9s %14s %8s %10s\n", "state", "readers", "p50 ns/op", "p99 ns/op",
+         "change", "reads/s", "torn", "retries");
+  for (count = 0; count <= readers; count = count ? count * 2 : 1)
+  {
+    Row(count, false);
+  }
+  for (count = 0; count <= readers; count = count ? count * 2 : 1)
+  {
+    Row(count, true);
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Bench Functions
+ *---------------------------------------------------------------------------*/
+
+// Batches of SNAPBENCH_BATCH publishes for the whole row; the median batch is
+// the steady cost, the 99th percentile shows the publisher being held up. The
+// batches are short so that a reader preempting the publisher on a shared cpu
+// lands in few of them
+static void Row(int readers, bool locked)
+{
+  ReaderObj *threads = calloc((size_t)(readers ? readers : 1), sizeof(ReaderObj));
+  ElevatorObj elevator;
+  uint64_t begin;
+  uint64_t batch;
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint32_t retries = snapshotRetries;
+  double p50;
+  double p99;
+  int count = 0;
+  int i;
+
+  memset(&elevator, 0, sizeof(elevator));
+  elevator.Elevator = CENTRAL_ELEVATOR;
+  elevator.ActualFloor = FLOOR_0;
+  elevator.TargetFloor = FLOOR_0;
+  elevator.Stops = FLOOR_BIT(FLOOR_0);
+  Publish(&elevator, locked);
+
+  running = true;
+  lockedRun = locked;
+  for (i = 0; i < readers; i++)
+  {
+    pthread_create(&threads[i].Thread, NULL, Reader, &threads[i]);
+  }
+
+  begin = Now();
+  do
+  {
+    batch = Now();
+    for (i = 0; i < SNAPBENCH_BATCH; i++)
+    {
+      Publish(&elevator, locked);
+    }
+    batches[count++] = Now() - batch;
+  } while (Now() - begin < (uint64_t)seconds * 1000000000ULL && count < SNAPBENCH_BATCHES);
+  running = false;
+
+  for (i = 0; i < readers; i++)
+  {
+    pthread_join(threads[i].Thread, NULL);
+    reads += threads[i].Reads;
+    torn += threads[i].Torn;
+  }
+  free(threads);
+
+  qsort(batches, (size_t)count, sizeof(batches[0]), Compare);
+  p50 = (double)batches[count / 2] / SNAPBENCH_BATCH;
+  p99 = (double)batches[count * 99 / 100] / SNAPBENCH_BATCH;
+  if (!readers)
+  {
+    baseline = p50;
+  }
+  printf("%-6s %7d %12.1f %12.1f %+8.1f%% %14.0f %8llu %10u\n", locked ? "mutex" : "latch", readers,
+         p50, p99, 100.0 * (p50 - baseline) / baseline, reads / (seconds * 1.0),
+         (unsigned long long)torn, locked ? 0 : snapshotRetries - retries);
+}
+
+// One step of a car walking the shaft: every field follows the floor, so a
+// snapshot mixing two publishes is caught by Torn
+static void Publish(ElevatorObj *elevator, bool locked)
+{
+  char floor = (char)(FLOOR_0 + (elevator->ActualFloor - FLOOR_0 + 1) % FLOORS);
+
+  elevator->ActualFloor = floor;
+  elevator->TargetFloor = floor;
+  elevator->Direction = (floor - FLOOR_0) & 1 ? UP : DOWN;
+  elevator->Stops = (uint16_t)FLOOR_BIT(floor);
+
+  if (!locked)
+  {
+    PublishSnapshot(elevator);
+    return;
+  }
+  pthread_mutex_lock(&mutex);
+  shared.Elevator = elevator->Elevator;
+  shared.Status = elevator->Status;
+  shared.ActualFloor = elevator->ActualFloor;
+  shared.TargetFloor = elevator->TargetFloor;
+  shared.Direction = elevator->Direction;
+  shared.Door = elevator->Door;
+  shared.Mode = elevator->Mode;
+  shared.Stops = elevator->Stops;
+  pthread_mutex_unlock(&mutex);
+}
+
+static void *Reader(void *argument)
+{
+  ReaderObj *reader = argument;
+  SnapshotObj snapshot;
+
+  while (running)
+  {
+    if (lockedRun)
+    {
+      pthread_mutex_lock(&mutex);
+      snapshot = shared;
+      pthread_mutex_unlock(&mutex);
+    }
+    else
+    {
+      ReadSnapshot(&snapshot);
+    }
+    reader->Reads++;
+    reader->Torn += Torn(&snapshot);
+  }
+  return NULL;
+}
+
+static bool Torn(const SnapshotObj *snapshot)
+{
+  return snapshot->TargetFloor != snapshot->ActualFloor ||
+         snapshot->Stops != FLOOR_BIT(snapshot->ActualFloor) ||
+         snapshot->Direction != ((snapshot->ActualFloor - FLOOR_0) & 1 ? UP : DOWN);
+}
+
+static int Compare(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static uint64_t Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
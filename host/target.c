@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "inc/hw_ints.h"
+#include "inc/hw_memmap.h"
+
+#include "driverlib/sysctl.h"
+#include "driverlib/uart.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/gpio.h"
+#include "driverlib/eeprom.h"
+#include "driverlib/systick.h"
+
+#include "TM4C129.h"
+#include "UART.h"
+
+#include "target.h"
+
+#define INT_SYSTICK 15          // exception number of the SysTick
+#define HOST_BAUD 115200        // UART0 rate set by the course driver
+#define HOST_REENTRY 64         // handler entries for one raise before giving up
+
+typedef struct {                // UART model data type
+  uint32_t Base;
+  uint32_t Interrupt;
+  unsigned char Fifo[HOST_FIFO];
+  int Head;
+  int Count;
+  int Level;                    // receive FIFO fill that raises RX
+  bool FifoEnabled;
+  uint32_t Mask;                // enabled interrupts
+  uint32_t Status;              // raw interrupt status
+  uint32_t Baud;
+  uint32_t TxBits;              // bits x 1000 still in the transmit FIFO
+} UartModel;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+void RtosTick(void);
+static UartModel *GetUart(uint32_t base);
+static void Raise(uint32_t interrupt);
+static void Dispatch(void);
+static void UartUpdate(UartModel *uart);
+static void EepromSave(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+HostObj host;
+HostUartObj hostUart[2];
+uint32_t SystemCoreClock = 120000000;
+const char *hostEepromFile;
+uint32_t hostEepromWrites;
+
+static volatile uint32_t hostTicks;
+static void (*handlers[NUM_INTERRUPTS])(void);
+static bool enabled[NUM_INTERRUPTS];
+static bool pending[NUM_INTERRUPTS];
+static bool masked;
+static bool inHandler;
+static bool sysTickEnabled;
+static uint8_t eeprom[HOST_EEPROM];
+static UartModel uarts[2] = {
+  {UART0_BASE, INT_UART0, {0}, 0, 0, 1, false, 0, 0, HOST_BAUD, 0},
+  {UART1_BASE, INT_UART1, {0}, 0, 0, 1, false, 0, 0, HOST_BAUD, 0},
+};
+
+/*----------------------------------------------------------------------------
+ *      Host Functions
+ *---------------------------------------------------------------------------*/
+
+// Advance the tick one ms at a time: SysTick, RTX timers and the transmit
+// FIFOs draining at their baud rate
+void HostTick(uint32_t ms)
+{
+  int i;
+
+  while (ms--)
+  {
+    hostTicks++;
+    for (i = 0; i < 2; i++)
+    {
+      uarts[i].TxBits = (uarts[i].TxBits > uarts[i].Baud) ? uarts[i].TxBits - uarts[i].Baud : 0;
+    }
+    if (sysTickEnabled)
+    {
+      Raise(INT_SYSTICK);
+    }
+    RtosTick();
+  }
+}
+
+uint32_t HostTicks()
+{
+  return hostTicks;
+}
+
+// Bytes arriving back to back on the line: RX is raised each time the FIFO
+// reaches its trigger level, RT once the line goes idle with bytes left
+void HostReceive(uint32_t base, const char *bytes, int size)
+{
+  UartModel *uart = GetUart(base);
+  int depth = uart->FifoEnabled ? HOST_FIFO : 1;
+  int i;
+
+  for (i = 0; i < size; i++)
+  {
+    if (uart->Count == depth)
+    {
+      hostUart[uart == &uarts[1]].Overruns++;
+      uart->Status |= UART_INT_OE;
+    }
+    else
+    {
+      uart->Fifo[(uart->Head + uart->Count) % HOST_FIFO] = (unsigned char)bytes[i];
+      uart->Count++;
+    }
+    if (uart->Count >= (uart->FifoEnabled ? uart->Level : 1))
+    {
+      uart->Status |= UART_INT_RX;
+      Raise(uart->Interrupt);
+    }
+  }
+
+  if (uart->Count)
+  {
+    uart->Status |= UART_INT_RT;
+    Raise(uart->Interrupt);
+  }
+}
+
+static UartModel *GetUart(uint32_t base)
+{
+  return (base == UART1_BASE) ? &uarts[1] : &uarts[0];
+}
+
+// Run the pending handlers unless masked or already inside one. A UART that
+// still flags an enabled interrupt after its handler is entered again, as the
+// NVIC would
+static void Raise(uint32_t interrupt)
+{
+  pending[interrupt] = true;
+  Dispatch();
+}
+
+static void Dispatch()
+{
+  static const uint32_t sources[] = {INT_SYSTICK, INT_UART0, INT_UART1};
+  uint32_t interrupt;
+  int entries;
+  int i;
+
+  if (masked || inHandler)
+  {
+    return;
+  }
+
+  inHandler = true;
+  for (i = 0; i < 3; i++)
+  {
+    interrupt = sources[i];
+    if (!pending[interrupt])
+    {
+      continue;
+    }
+    if (interrupt != INT_SYSTICK && !enabled[interrupt])
+    {
+      continue; // stays pending until enabled, as in the NVIC
+    }
+    pending[interrupt] = false;
+    if (!handlers[interrupt])
+    {
+      continue;
+    }
+
+    for (entries = 0; entries < HOST_REENTRY; entries++)
+    {
+      handlers[interrupt]();
+      if (interrupt == INT_UART0 || interrupt == INT_UART1)
+      {
+        UartModel *uart = &uarts[interrupt == INT_UART1];
+
+        hostUart[interrupt == INT_UART1].Interrupts++;
+        UartUpdate(uart);
+        if (uart->Status & uart->Mask)
+        {
+          continue;
+        }
+      }
+      break;
+    }
+  }
+  inHandler = false;
+}
+
+// RX clears once the FIFO is read below the trigger level, RT once it is empty
+static void UartUpdate(UartModel *uart)
+{
+  if (uart->Count < (uart->FifoEnabled ? uart->Level : 1))
+  {
+    uart->Status &= ~UART_INT_RX;
+  }
+  if (uart->Count == 0)
+  {
+    uart->Status &= ~UART_INT_RT;
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Core Functions
+ *---------------------------------------------------------------------------*/
+
+void __WFI()
+{
+  if (host.Idle)
+  {
+    host.Idle();
+  }
+  else
+  {
+    HostTick(1);
+  }
+}
+
+uint32_t ITM_SendChar(uint32_t ch)
+{
+  if (host.Trace)
+  {
+    host.Trace((char)ch);
+  }
+  return ch;
+}
+
+bool IntMasterEnable()
+{
+  bool was = masked;
+
+  masked = false;
+  Dispatch();
+  return was;
+}
+
+bool IntMasterDisable()
+{
+  bool was = masked;
+
+  masked = true;
+  return was;
+}
+
+void IntRegister(uint32_t interrupt, void (*handler)(void))
+{
+  handlers[interrupt] = handler;
+}
+
+void IntEnable(uint32_t interrupt)
+{
+  enabled[interrupt] = true;
+  Dispatch();
+}
+
+void IntDisable(uint32_t interrupt)
+{
+  enabled[interrupt] = false;
+}
+
+void SysTickPeriodSet(uint32_t period)
+{
+}
+
+void SysTickIntRegister(void (*handler)(void))
+{
+  handlers[INT_SYSTICK] = handler;
+}
+
+void SysTickIntEnable()
+{
+}
+
+void SysTickEnable()
+{
+  sysTickEnabled = true;
+}
+
+void SysCtlPeripheralEnable(uint32_t peripheral)
+{
+}
+
+bool SysCtlPeripheralReady(uint32_t peripheral)
+{
+  return true;
+}
+
+void GPIOPinConfigure(uint32_t pinConfig)
+{
+}
+
+void GPIOPinTypeUART(uint32_t port, uint8_t pins)
+{
+}
+
+/*----------------------------------------------------------------------------
+ *      UART Functions
+ *---------------------------------------------------------------------------*/
+
+void UARTConfigSetExpClk(uint32_t base, uint32_t uartClk, uint32_t baud, uint32_t config)
+{
+  GetUart(base)->Baud = baud;
+}
+
+void UARTEnable(uint32_t base)
+{
+}
+
+void UARTFIFOEnable(uint32_t base)
+{
+  GetUart(base)->FifoEnabled = true;
+}
+
+// RX1_8..RX7_8 are 2, 4, 8, 12 and 14 bytes of the 16 byte FIFO
+void UARTFIFOLevelSet(uint32_t base, uint32_t txLevel, uint32_t rxLevel)
+{
+  static const int levels[] = {2, 4, 8, 12, 14};
+
+  GetUart(base)->Level = levels[(rxLevel >> 3) % 5];
+}
+
+void UARTIntEnable(uint32_t base, uint32_t intFlags)
+{
+  GetUart(base)->Mask |= intFlags;
+}
+
+uint32_t UARTIntStatus(uint32_t base, bool masked)
+{
+  UartModel *uart = GetUart(base);
+
+  return masked ? uart->Status & uart->Mask : uart->Status;
+}
+
+void UARTIntClear(uint32_t base, uint32_t intFlags)
+{
+  GetUart(base)->Status &= ~intFlags;
+}
+
+bool UARTCharsAvail(uint32_t base)
+{
+  return GetUart(base)->Count > 0;
+}
+
+int32_t UARTCharGetNonBlocking(uint32_t base)
+{
+  UartModel *uart = GetUart(base);
+  unsigned char data;
+
+  if (!uart->Count)
+  {
+    return -1;
+  }
+  data = uart->Fifo[uart->Head];
+  uart->Head = (uart->Head + 1) % HOST_FIFO;
+  uart->Count--;
+  return data;
+}
+
+// The transmit FIFO fills at 10 bits per byte and drains at the baud rate
+bool UARTSpaceAvail(uint32_t base)
+{
+  UartModel *uart = GetUart(base);
+
+  return uart->TxBits + 10000 <= HOST_FIFO * 10000;
+}
+
+bool UARTCharPutNonBlocking(uint32_t base, unsigned char data)
+{
+  if (!UARTSpaceAvail(base))
+  {
+    return false;
+  }
+  UARTCharPut(base, data);
+  return true;
+}
+
+// Blocking on the target, here the byte is sent as if the FIFO had waited
+void UARTCharPut(uint32_t base, unsigned char data)
+{
+  UartModel *uart = GetUart(base);
+
+  if (UARTSpaceAvail(base))
+  {
+    uart->TxBits += 10000;
+  }
+  if (host.Transmit)
+  {
+    host.Transmit(base, data);
+  }
+}
+
+// Course driver: FIFO on at the reset trigger level, one character at a time
+void UART_Init()
+{
+  uarts[0].FifoEnabled = true;
+  uarts[0].Level = 8;
+}
+
+char UART_InChar()
+{
+  return (char)UARTCharGetNonBlocking(UART0_BASE);
+}
+
+void UART_OutChar(char data)
+{
+  if (host.Transmit)
+  {
+    host.Transmit(UART0_BASE, (unsigned char)data);
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      EEPROM Functions
+ *---------------------------------------------------------------------------*/
+
+// Blank is all ones, as on the part; the file keeps the image across runs
+uint32_t EEPROMInit()
+{
+  FILE *file;
+
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  if (hostEepromFile && (file = fopen(hostEepromFile, "rb")) != NULL)
+  {
+    if (fread(eeprom, 1, sizeof(eeprom), file) != sizeof(eeprom))
+    {
+      memset(eeprom, 0xFF, sizeof(eeprom));
+    }
+    fclose(file);
+  }
+  return EEPROM_INIT_OK;
+}
+
+uint32_t EEPROMSizeGet()
+{
+  return HOST_EEPROM;
+}
+
+void EEPROMRead(uint32_t *data, uint32_t address, uint32_t count)
+{
+  if (address + count <= HOST_EEPROM)
+  {
+    memcpy(data, &eeprom[address], count);
+  }
+}
+
+uint32_t EEPROMProgram(uint32_t *data, uint32_t address, uint32_t count)
+{
+  if (address + count > HOST_EEPROM)
+  {
+    return 1;
+  }
+  memcpy(&eeprom[address], data, count);
+  hostEepromWrites++;
+  EepromSave();
+  return 0;
+}
+
+static void EepromSave()
+{
+  FILE *file;
+
+  if (hostEepromFile && (file = fopen(hostEepromFile, "wb")) != NULL)
+  {
+    fwrite(eeprom, 1, sizeof(eeprom), file);
+    fclose(file);
+  }
+}
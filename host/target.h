@@ -0,0 +1,40 @@
+#ifndef TARGET_H
+#define TARGET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *      Host Target
+ *
+ * Stand-in for the TM4C1294 peripherals, the course UART0 driver and RTX that
+ * main.c is built against on the host. The tools drive it: HostTick advances
+ * the ms tick (SysTick and RTX timers), HostReceive delivers bytes on a UART
+ * and raises its interrupt the way the FIFO would, and the hooks collect what
+ * the controller sends.
+ *---------------------------------------------------------------------------*/
+
+#define HOST_FIFO 16                            // bytes in each UART receive FIFO
+#define HOST_EEPROM 6144                        // bytes of the TM4C1294 EEPROM
+
+typedef struct {                                // hooks set by the tools
+  void (*Idle)(void);                           // __WFI, nothing left to do
+  void (*Transmit)(uint32_t base, unsigned char byte); // byte sent on a UART
+  void (*Trace)(char ch);                       // ITM stimulus port 0
+} HostObj;
+
+typedef struct {                                // UART model counters
+  uint32_t Interrupts;                          // handler entries
+  uint32_t Overruns;                            // bytes lost to a full FIFO
+} HostUartObj;
+
+extern HostObj host;
+extern HostUartObj hostUart[2];                 // UART0, UART1
+extern const char *hostEepromFile;              // backing file, NULL keeps it in RAM
+extern uint32_t hostEepromWrites;               // EEPROMProgram calls
+
+void HostTick(uint32_t ms);
+uint32_t HostTicks(void);
+void HostReceive(uint32_t base, const char *bytes, int size);
+
+#endif
@@ -0,0 +1,167 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "misc.h"
+
+#include "telemetry.h"
+
+/*----------------------------------------------------------------------------
+ *      Telemetry Functions
+ *---------------------------------------------------------------------------*/
+
+// Same CRC as Crc16 in main.c, written again so the decoder checks the
+// firmware rather than itself
+uint16_t TelemetryCrc(const uint8_t *data, int size)
+{
+  uint16_t crc = 0xFFFF;
+  int i;
+  int bit;
+
+  for (i = 0; i < size; i++)
+  {
+    crc ^= (uint16_t)(data[i] << 8);
+    for (bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Inverse of CobsEncode, -1 when a code points past the end of the frame
+int TelemetryCobsDecode(const uint8_t *frame, int size, uint8_t *data)
+{
+  int length = 0;
+  int code;
+  int i = 0;
+  int j;
+
+  while (i < size)
+  {
+    code = frame[i++];
+    if (code == 0 || i + code - 1 > size)
+    {
+      return -1;
+    }
+    for (j = 1; j < code; j++)
+    {
+      data[length++] = frame[i++];
+    }
+    if (code < 0xFF && i < size)
+    {
+      data[length++] = 0;
+    }
+  }
+  return length;
+}
+
+// Bytes as they come off the line, in any chunks. A frame is only judged at
+// its delimiter, so a record cut short by a full FIFO costs that record alone
+void TelemetryPush(TelemetryDecoderObj *decoder, const uint8_t *bytes, int size,
+                   TelemetryRecordFunc record, void *context)
+{
+  uint8_t data[TELEMETRY_BUFFER];
+  int length;
+  int i;
+
+  for (i = 0; i < size; i++)
+  {
+    if (bytes[i] != TELEMETRY_DELIMITER)
+    {
+      if (decoder->Size < TELEMETRY_BUFFER)
+      {
+        decoder->Buffer[decoder->Size++] = bytes[i];
+      }
+      else
+      {
+        decoder->Overflow = true;
+      }
+      continue;
+    }
+
+    if (decoder->Size == 0)
+    {
+      continue; // resync delimiter or line noise
+    }
+    length = decoder->Overflow ? -1 : TelemetryCobsDecode(decoder->Buffer, decoder->Size, data);
+    if (length < 3 || length > TELEMETRY_RECORD
+        || TelemetryCrc(data, length - 2) != (uint16_t)(data[length - 2] | data[length - 1] << 8))
+    {
+      decoder->BadFrames++;
+    }
+    else
+    {
+      decoder->Frames++;
+      record(context, data, length - 2);
+    }
+    decoder->Size = 0;
+    decoder->Overflow = false;
+  }
+}
+
+// Field by field, as TelemetryFlush lays them out
+bool TelemetryParse(const uint8_t *record, int size, TelemetryObj *telemetry)
+{
+  int expected;
+  int i = 3;
+
+  memset(telemetry, 0, sizeof(*telemetry));
+  if (size < 3)
+  {
+    return false;
+  }
+  telemetry->Sequence = record[0];
+  telemetry->Car = (char)record[1];
+
+  if (telemetry->Car == TELEMETRY_ANNOUNCE)
+  {
+    if (size != 5)
+    {
+      return false;
+    }
+    telemetry->Controller = record[2];
+    telemetry->Dropped = (uint16_t)(record[3] | record[4] << 8);
+    return true;
+  }
+
+  if (telemetry->Car == TELEMETRY_CAPTURE)
+  {
+    telemetry->Direction = (char)record[2];
+    if (telemetry->Direction == CAPTURE_START)
+    {
+      if (size != 5)
+      {
+        return false;
+      }
+      telemetry->Count = (uint16_t)(record[3] | record[4] << 8);
+      return true;
+    }
+    telemetry->Size = size - 7;
+    if (telemetry->Size < 1 || telemetry->Size > (int)sizeof(telemetry->Command))
+    {
+      return false;
+    }
+    telemetry->Time = (uint32_t)record[3] | (uint32_t)record[4] << 8 | (uint32_t)record[5] << 16
+                      | (uint32_t)record[6] << 24;
+    memcpy(telemetry->Command, &record[7], (size_t)telemetry->Size);
+    return true;
+  }
+
+  telemetry->Flags = record[2];
+  expected = 3 + !!(telemetry->Flags & TELEMETRY_FLOOR) + !!(telemetry->Flags & TELEMETRY_DOOR)
+             + !!(telemetry->Flags & TELEMETRY_DIRECTION) + 2 * !!(telemetry->Flags & TELEMETRY_STOPS);
+  if (size != expected)
+  {
+    return false;
+  }
+  if (telemetry->Flags & TELEMETRY_FLOOR)
+    telemetry->Floor = record[i++];
+  if (telemetry->Flags & TELEMETRY_DOOR)
+    telemetry->Door = (char)record[i++];
+  if (telemetry->Flags & TELEMETRY_DIRECTION)
+    telemetry->Direction = (char)record[i++];
+  if (telemetry->Flags & TELEMETRY_STOPS)
+    telemetry->Stops = (uint16_t)(record[i] | record[i + 1] << 8);
+  return true;
+}
@@ -0,0 +1,53 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *      Telemetry Decoder
+ *
+ * Host side of the UART1 telemetry stream of main.c: COBS frames ended by a
+ * zero byte, each holding a record followed by its CRC-16/CCITT-FALSE. The
+ * record is sequence, car id, field flags and the fields the flags select,
+ * or sequence, '@', controller id and dropped byte count for an announce.
+ * A capture dump comes as sequence, '*', 'S' and the frame count, then
+ * sequence, '*', direction, tick and the bytes of each frame.
+ *---------------------------------------------------------------------------*/
+
+#define TELEMETRY_BUFFER 64     // encoded bytes kept while a frame is open
+
+typedef struct {                // decoded record data type
+  uint8_t Sequence;
+  char Car;                     // car id, TELEMETRY_ANNOUNCE or TELEMETRY_CAPTURE
+  uint8_t Flags;                // TELEMETRY_FLOOR..TELEMETRY_STOPS present
+  uint8_t Floor;                // index, 0 for FLOOR_0
+  char Door;
+  char Direction;               // or CAPTURE_START, CAPTURE_RX, CAPTURE_TX
+  uint16_t Stops;
+  uint8_t Controller;           // announce only
+  uint16_t Dropped;             // announce only, bytes the controller dropped
+  uint16_t Count;               // capture start only, frames in the dump
+  uint32_t Time;                // capture only, tick the frame was seen at
+  int Size;                     // capture only
+  char Command[10];
+} TelemetryObj;
+
+typedef struct {                // stream decoder data type
+  uint8_t Buffer[TELEMETRY_BUFFER];
+  int Size;
+  bool Overflow;                // frame longer than any record, skipped to its end
+  uint64_t Frames;              // records with a good CRC
+  uint64_t BadFrames;           // frames dropped for their length or CRC
+} TelemetryDecoderObj;
+
+// Called for every good record, without its CRC
+typedef void (*TelemetryRecordFunc)(void *context, const uint8_t *record, int size);
+
+uint16_t TelemetryCrc(const uint8_t *data, int size);
+int TelemetryCobsDecode(const uint8_t *frame, int size, uint8_t *data);
+void TelemetryPush(TelemetryDecoderObj *decoder, const uint8_t *bytes, int size,
+                   TelemetryRecordFunc record, void *context);
+bool TelemetryParse(const uint8_t *record, int size, TelemetryObj *telemetry);
+
+#endif
@@ -0,0 +1,319 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "inc/hw_memmap.h"
+
+#include "target.h"
+#include "controller.h"
+#include "telemetry.h"
+
+#define TELSTAT_CARS 128        // car ids tracked, indexed by the id byte
+#define TELSTAT_SECONDS 600     // simulated s of traffic with -m
+#define TELSTAT_CALL 20000      // mean ms between two calls with -m
+#define TELSTAT_FLOOR 1500      // ms the model car takes per floor
+#define TELSTAT_DOOR 2000       // ms the model door takes to open or close
+#define TELSTAT_EVENTS 64
+#define TELSTAT_LINE 11520      // bytes/s UART1 carries at 115200 baud
+
+typedef struct {                // per car statistics data type
+  uint64_t Records;
+  uint64_t Bytes;               // frame bytes: record, CRC, COBS code, delimiter
+} CarStatObj;
+
+typedef struct {                // frame the model sends when its time comes
+  uint32_t Time;
+  char Frame[8];
+} EventObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Record(void *context, const uint8_t *record, int size);
+static void Report(double seconds);
+static double Now(void);
+static void Measure(uint32_t seconds, uint32_t call);
+static void Schedule(uint32_t delay, const char *frame);
+static void Transmit(uint32_t base, unsigned char byte);
+static void Idle(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static TelemetryDecoderObj decoder;
+static CarStatObj cars[TELSTAT_CARS];
+static bool quiet;
+
+static EventObj events[TELSTAT_EVENTS];
+static int eventCount;
+static char txFrame[16];        // frame the controller is sending on UART0
+static int txSize;
+static int floorNumber;         // model car
+static int moving;              // +1 up, -1 down, 0 stopped
+static uint32_t nextFloor;      // tick of the next floor report while moving
+static uint32_t nextCall;
+static uint32_t meanCall;
+static uint32_t endTime;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// Decodes the UART1 stream of a controller, from a capture file, the line
+// itself or stdin, printing each record and the bytes per second each car
+// takes. With -m it measures instead: the controller runs on the
+// host target against a model car answering on UART0, random calls arrive,
+// and its own UART1 output is decoded over that many simulated seconds
+int main(int argc, char **argv)
+{
+  uint8_t bytes[4096];
+  uint32_t measure = 0;
+  uint32_t call = TELSTAT_CALL;
+  double start;
+  ssize_t size;
+  int fd = STDIN_FILENO;
+  int option;
+
+  while ((option = getopt(argc, argv, "m:c:q")) != -1)
+  {
+    if (option == 'm')
+      measure = (uint32_t)atoi(optarg);
+    else if (option == 'c')
+      call = (uint32_t)atoi(optarg);
+    else if (option == 'q')
+      quiet = true;
+    else
+    {
+      fprintf(stderr, "usage: %s [-q] [file|line]\n"
+                      "       %s -m seconds [-c ms between calls] [-q]\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  if (measure)
+  {
+    Measure(measure, call);
+    return 0;
+  }
+
+  if (optind < argc && (fd = open(argv[optind], O_RDONLY | O_NOCTTY)) < 0)
+  {
+    fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  start = Now();
+  while ((size = read(fd, bytes, sizeof(bytes))) > 0)
+  {
+    TelemetryPush(&decoder, bytes, (int)size, Record, NULL);
+  }
+  Report(Now() - start);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Decoder Functions
+ *---------------------------------------------------------------------------*/
+
+// The frame bytes of a record are its size, the CRC, the COBS code byte and
+// the delimiter: a record is far shorter than the 254 bytes of one COBS run
+static void Record(void *context, const uint8_t *record, int size)
+{
+  TelemetryObj telemetry;
+
+  cars[record[1] % TELSTAT_CARS].Records++;
+  cars[record[1] % TELSTAT_CARS].Bytes += (uint64_t)size + 4;
+  if (quiet)
+  {
+    return;
+  }
+
+  if (!TelemetryParse(record, size, &telemetry))
+  {
+    printf("%3u ? %d bytes\n", record[0], size);
+  }
+  else if (telemetry.Car == TELEMETRY_ANNOUNCE)
+  {
+    printf("%3u controller %u dropped %u\n", telemetry.Sequence, telemetry.Controller, telemetry.Dropped);
+  }
+  else if (telemetry.Car == TELEMETRY_CAPTURE)
+  {
+    if (telemetry.Direction == CAPTURE_START)
+      printf("%3u capture of %u frames\n", telemetry.Sequence, telemetry.Count);
+    else
+      printf("%3u capture %c %u ms %.*s\n", telemetry.Sequence, telemetry.Direction, telemetry.Time,
+             telemetry.Size, telemetry.Command);
+  }
+  else
+  {
+    printf("%3u car %c", telemetry.Sequence, telemetry.Car);
+    if (telemetry.Flags & TELEMETRY_FLOOR)
+      printf(" floor %u", telemetry.Floor);
+    if (telemetry.Flags & TELEMETRY_DOOR)
+      printf(" door %c", telemetry.Door);
+    if (telemetry.Flags & TELEMETRY_DIRECTION)
+      printf(" direction %c", telemetry.Direction);
+    if (telemetry.Flags & TELEMETRY_STOPS)
+      printf(" stops %04x", telemetry.Stops);
+    printf("\n");
+  }
+}
+
+// Per car id, with the share of the UART1 line when the time is known
+static void Report(double seconds)
+{
+  int i;
+
+  printf("%-10s %10s %10s %10s %8s\n", "car", "records", "bytes", "bytes/s", "line %");
+  for (i = 0; i < TELSTAT_CARS; i++)
+  {
+    if (!cars[i].Records)
+    {
+      continue;
+    }
+    printf("%-10c %10llu %10llu %10.2f %8.3f\n", i == TELEMETRY_ANNOUNCE ? '@' : i,
+           (unsigned long long)cars[i].Records, (unsigned long long)cars[i].Bytes,
+           cars[i].Bytes / seconds, 100.0 * cars[i].Bytes / seconds / TELSTAT_LINE);
+  }
+  printf("%llu records, %llu bad frames in %.1f s\n", (unsigned long long)decoder.Frames,
+         (unsigned long long)decoder.BadFrames, seconds);
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*----------------------------------------------------------------------------
+ *      Model Functions
+ *---------------------------------------------------------------------------*/
+
+// The event loop never returns: Idle ends the run from inside it
+static void Measure(uint32_t seconds, uint32_t call)
+{
+  srand(1);
+  meanCall = call;
+  nextCall = call;
+  endTime = seconds * 1000;
+  host.Transmit = Transmit;
+  host.Idle = Idle;
+  ControllerMain();
+}
+
+static void Schedule(uint32_t delay, const char *frame)
+{
+  if (eventCount < TELSTAT_EVENTS)
+  {
+    events[eventCount].Time = HostTicks() + delay;
+    strncpy(events[eventCount].Frame, frame, sizeof(events[eventCount].Frame) - 1);
+    eventCount++;
+  }
+}
+
+// UART1 goes to the decoder, UART0 frames move the model car. Nothing is sent
+// back from here, the controller may be inside its ISR or a masked section
+static void Transmit(uint32_t base, unsigned char byte)
+{
+  if (base == UART1_BASE)
+  {
+    TelemetryPush(&decoder, &byte, 1, Record, NULL);
+    return;
+  }
+
+  if (byte != END_COMMAND)
+  {
+    if (txSize < (int)sizeof(txFrame))
+    {
+      txFrame[txSize++] = (char)byte;
+    }
+    return;
+  }
+  if (txSize >= 2 && txFrame[0] == CENTRAL_ELEVATOR)
+  {
+    switch (txFrame[1])
+    {
+    case INIT_ELEVATOR:
+      floorNumber = 0;
+      moving = 0;
+      break;
+    case UP:
+    case DOWN:
+      moving = (txFrame[1] == UP) ? 1 : -1;
+      nextFloor = HostTicks() + TELSTAT_FLOOR;
+      break;
+    case STOP:
+      moving = 0;
+      break;
+    case OPEN:
+      Schedule(TELSTAT_DOOR, "cA\r");
+      break;
+    case CLOSED:
+      Schedule(TELSTAT_DOOR, "cF\r");
+      break;
+    }
+  }
+  txSize = 0;
+}
+
+// One ms: frames due, the car passing a floor and calls arriving on average
+// every meanCall ms, half from the car panel, half from the halls
+static void Idle()
+{
+  char frame[16];
+  int floor;
+  int i;
+
+  HostTick(1);
+  if (HostTicks() >= endTime)
+  {
+    printf("controller: %u records, %u bytes, %u bytes dropped\n", (unsigned)telemetryRecords,
+           (unsigned)telemetryBytes, (unsigned)telemetryDropped);
+    Report(endTime / 1000.0);
+    exit(0);
+  }
+
+  for (i = 0; i < eventCount; i++)
+  {
+    if ((int32_t)(HostTicks() - events[i].Time) >= 0)
+    {
+      strcpy(frame, events[i].Frame);
+      events[i] = events[--eventCount];
+      HostReceive(UART0_BASE, frame, (int)strlen(frame));
+      i--;
+    }
+  }
+
+  if (moving && (int32_t)(HostTicks() - nextFloor) >= 0)
+  {
+    floorNumber += moving;
+    if (floorNumber < 0 || floorNumber >= FLOORS)
+    {
+      floorNumber -= moving;
+      moving = 0;
+    }
+    nextFloor = HostTicks() + TELSTAT_FLOOR;
+    snprintf(frame, sizeof(frame), "c%d\r", floorNumber);
+    HostReceive(UART0_BASE, frame, (int)strlen(frame));
+  }
+
+  if ((int32_t)(HostTicks() - nextCall) >= 0)
+  {
+    floor = rand() % FLOORS;
+    if (rand() % 2)
+      snprintf(frame, sizeof(frame), "cI%c\r", FLOOR_0 + floor);
+    else
+      snprintf(frame, sizeof(frame), "cE%02d%c\r", floor, (floor == FLOORS - 1 || (floor && rand() % 2)) ? 'd' : 's');
+    HostReceive(UART0_BASE, frame, (int)strlen(frame));
+    nextCall = HostTicks() + 1 + (uint32_t)(rand() % (2 * meanCall));
+  }
+}
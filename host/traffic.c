@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "target.h"
+#include "controller.h"
+#include "building.h"
+#include "harness.h"
+
+#define TRAFFIC_SECONDS 3600    // simulated s of traffic
+
+typedef struct {                // one run, passed back from its child data type
+  BuildingObj Building;
+  uint32_t Outages;             // times the controller took car 'c' out of service
+  uint32_t OutageTime;          // ms it kept it out
+  double Depth;                 // frames in the controller's queues, on average
+  uint32_t DepthMax;
+  uint32_t Collapsed;           // presses collapsed on ingress
+  uint32_t Rejected;            // calls to floors out of range
+  double Seconds;               // wall clock
+} RunObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static bool Run(const BuildingConfigObj *config, uint32_t seconds, RunObj *run);
+static void Report(const BuildingConfigObj *config, const RunObj *run, uint32_t seconds);
+static void Penalty(const RunObj *healthy, const RunObj *failed);
+static bool Sample(const BuildingObj *building);
+static double Now(void);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static RunObj runs[2];
+static uint64_t depthTotal;     // frames queued, summed over the samples
+static uint32_t depthSamples;
+static uint32_t depthMax;
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// End-to-end run of the controller against the building model:
+// passengers arrive at random, call, ride and leave, and the run reports
+// what they waited and what the car spent to carry them. With -m the
+// waiting passengers mash their button every that many ms, lit or not; the
+// queue depth and the waits should stay where they are without it. With -e
+// the fire panel sends EVACUATE at that second with -n occupants on every
+// floor above the exit, and the run ends once the building is clear,
+// reporting the clear-out time from the fire panel frame to the last
+// occupant out
+// With -f car 'c' loses its link and drive at that second for -F seconds;
+// the same seed is run without the outage as well and the difference in
+// waits is the penalty of losing the car
+int main(int argc, char **argv)
+{
+  BuildingConfigObj config;
+  BuildingConfigObj healthy;
+  uint32_t seconds = TRAFFIC_SECONDS;
+  int option;
+
+  BuildingDefaults(&config);
+  config.FailFor = 120000;
+  while ((option = getopt(argc, argv, "s:a:l:c:o:r:m:e:n:f:F:")) != -1)
+  {
+    if (option == 's')
+      seconds = (uint32_t)atoi(optarg);
+    else if (option == 'a')
+      config.Arrivals = atof(optarg);
+    else if (option == 'l')
+      config.Latency = (uint32_t)atoi(optarg);
+    else if (option == 'c')
+      config.Capacity = atoi(optarg);
+    else if (option == 'o')
+      config.Reopen = atof(optarg);
+    else if (option == 'r')
+      config.Seed = (uint32_t)atoi(optarg);
+    else if (option == 'm')
+      config.Mash = (uint32_t)atoi(optarg);
+    else if (option == 'e')
+      config.EvacuateAt = (uint32_t)atoi(optarg) * 1000;
+    else if (option == 'n')
+      config.Occupants = atoi(optarg);
+    else if (option == 'f')
+      config.FailAt = (uint32_t)atoi(optarg) * 1000;
+    else if (option == 'F')
+      config.FailFor = (uint32_t)atoi(optarg) * 1000;
+    else
+    {
+      fprintf(stderr, "usage: %s [-s seconds] [-a arrivals/min] [-l latency ms] [-c capacity]\n"
+                      "          [-o reopen share] [-r seed] [-m mash ms]\n"
+                      "          [-e evacuate at s [-n occupants per floor]] [-f fail at s [-F for s]]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // Each run in a child of its own, the controller cannot be reset in process
+  if (!config.FailAt)
+  {
+    if (!Run(&config, seconds, &runs[0]))
+    {
+      return 1;
+    }
+    Report(&config, &runs[0], seconds);
+    return 0;
+  }
+
+  healthy = config;
+  healthy.FailAt = 0;
+  if (!Run(&healthy, seconds, &runs[0]) || !Run(&config, seconds, &runs[1]))
+  {
+    return 1;
+  }
+  printf("without the outage\n");
+  Report(&healthy, &runs[0], seconds);
+  printf("\ncar 'c' out from %u s for %u s\n", config.FailAt / 1000, config.FailFor / 1000);
+  Report(&config, &runs[1], seconds);
+  printf("\n");
+  Penalty(&runs[0], &runs[1]);
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Run Functions
+ *---------------------------------------------------------------------------*/
+
+static bool Run(const BuildingConfigObj *config, uint32_t seconds, RunObj *run)
+{
+  char *bytes = (char *)run;
+  size_t done = 0;
+  ssize_t size;
+  int fds[2];
+  int status;
+  pid_t pid;
+
+  if (pipe(fds) || (pid = fork()) < 0)
+  {
+    perror("fork");
+    return false;
+  }
+  if (pid == 0)
+  {
+    double start = Now();
+
+    close(fds[0]);
+    BuildingInit(&run->Building, config);
+    HarnessRun(&run->Building, seconds * 1000, Sample);
+    BuildingFinish(&run->Building);
+    run->Outages = outages[0];
+    run->OutageTime = outageTime[0];
+    run->Depth = depthSamples ? (double)depthTotal / depthSamples : 0.0;
+    run->DepthMax = depthMax;
+    run->Collapsed = collapsedCalls[0];
+    run->Rejected = rejectedCalls;
+    run->Seconds = Now() - start;
+    while (done < sizeof(*run) && (size = write(fds[1], bytes + done, sizeof(*run) - done)) > 0)
+    {
+      done += (size_t)size;
+    }
+    _exit(done == sizeof(*run) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  while (done < sizeof(*run) && (size = read(fds[0], bytes + done, sizeof(*run) - done)) > 0)
+  {
+    done += (size_t)size;
+  }
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  if (done != sizeof(*run) || !WIFEXITED(status) || WEXITSTATUS(status))
+  {
+    fprintf(stderr, "run failed\n");
+    return false;
+  }
+  return true;
+}
+
+/*----------------------------------------------------------------------------
+ *      Report Functions
+ *---------------------------------------------------------------------------*/
+
+static void Report(const BuildingConfigObj *config, const RunObj *run, uint32_t seconds)
+{
+  const BuildingStatsObj *stats = &run->Building.Stats;
+
+  printf("%u s simulated in %.2f s\n", run->Building.Now / 1000, run->Seconds);
+  BuildingReport(&run->Building, stdout);
+  printf("queues      avg %.2f frames, max %u, %u presses collapsed, %u rejected\n",
+         run->Depth, run->DepthMax, run->Collapsed, run->Rejected);
+  if (config->FailAt)
+  {
+    printf("outage      %u times out of service, %.1f s in all\n", run->Outages, run->OutageTime / 1000.0);
+  }
+  if (config->EvacuateAt && stats->EvacuationTime)
+  {
+    printf("evacuation  %d occupants out in %.1f s\n", config->Occupants * (FLOORS - 1),
+           stats->EvacuationTime / 1000.0);
+  }
+  else if (config->EvacuateAt)
+  {
+    printf("evacuation  %u of %d occupants still in after %u s\n", stats->EvacuationLeft,
+           config->Occupants * (FLOORS - 1), seconds);
+  }
+}
+
+// Same passengers at the same times, so every difference is the outage's
+static void Penalty(const RunObj *healthy, const RunObj *failed)
+{
+  const BuildingStatsObj *a = &healthy->Building.Stats;
+  const BuildingStatsObj *b = &failed->Building.Stats;
+  double waitA = a->Served ? (double)a->WaitTotal / a->Served : 0;
+  double waitB = b->Served ? (double)b->WaitTotal / b->Served : 0;
+
+  printf("penalty     wait avg %+.1f s, p95 %+d s, max %+.1f s, %+d unserved, %+.0f kJ\n",
+         (waitB - waitA) / 1000.0,
+         ((int)BuildingPercentile(b, 0.95) - (int)BuildingPercentile(a, 0.95)) / 1000,
+         ((double)b->WaitMax - a->WaitMax) / 1000.0, (int)b->Unserved - (int)a->Unserved,
+         BuildingEnergy(&failed->Building) - BuildingEnergy(&healthy->Building));
+}
+
+// Samples the frames waiting in the controller's queues once per ms, and
+// stops the run once the last occupant of an evacuation is out
+static bool Sample(const BuildingObj *building)
+{
+  uint32_t depth;
+
+#if USE_RTOS
+  depth = osMessageQueueGetCount(qidMain) + osMessageQueueGetCount(qidCentralCommands)
+        + osMessageQueueGetCount(qidCentralResponses);
+#else
+  depth = (ringMain.Head - ringMain.Tail) + (ringCentralCommands.Head - ringCentralCommands.Tail)
+        + (ringCentralResponses.Head - ringCentralResponses.Tail);
+#endif
+  depthTotal += depth;
+  depthSamples++;
+  if (depth > depthMax)
+  {
+    depthMax = depth;
+  }
+  return building->Stats.EvacuationTime != 0;
+}
+
+static double Now()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "inc/hw_memmap.h"
+#include "driverlib/uart.h"
+
+#include "target.h"
+#include "controller.h"
+
+#define UARTBENCH_ROUNDS 20000  // streams fed for each row
+#define UARTBENCH_QUEUE 16      // depth of the stand-in for qidMain
+
+typedef struct {                // receive FIFO level data type
+  const char *Name;
+  uint32_t Level;               // UART_FIFO_RXn_8, as UART_RX_LEVEL
+} LevelObj;
+
+/*----------------------------------------------------------------------------
+ *      Declare Functions
+ *---------------------------------------------------------------------------*/
+static void Row(const LevelObj *level, bool spaced);
+static void Feed(bool spaced);
+
+/*----------------------------------------------------------------------------
+ *      Global Variables
+ *---------------------------------------------------------------------------*/
+static int rounds = UARTBENCH_ROUNDS;
+
+static const LevelObj levels[] = {
+  {"RX1_8", UART_FIFO_RX1_8},
+  {"RX2_8", UART_FIFO_RX2_8},
+  {"RX4_8", UART_FIFO_RX4_8},
+  {"RX6_8", UART_FIFO_RX6_8},
+  {"RX7_8", UART_FIFO_RX7_8},
+};
+
+// Floor reports, acks, hall and car calls of cars c, d and e, interleaved on
+// the one UART0 line as the three cars share it
+static const char *frames[] = {
+  "c5\r", "dE05s\r", "eA\r", "c6\r", "dI9\r", "e3\r",
+  "cF\r", "d4\r", "eE12d\r", "c7\r", "dA\r", "eI1\r",
+};
+
+/*----------------------------------------------------------------------------
+ *      Main Function
+ *---------------------------------------------------------------------------*/
+
+// UART0 receive interrupts per frame and ns per byte drained at each receive
+// FIFO level UART_RX_LEVEL can take. burst feeds the frames back to back, so
+// the FIFO level raises RX and only the tail of the stream waits for the
+// timeout; spaced leaves the line idle after each frame, so every frame ends
+// on an RT. The level is set on the same register UART_RX_LEVEL writes at
+// setup, one build covers them all. ns per byte is the host figure, on the
+// board probeUart counts cycles and the same ratio is cycles per byte
+int main(int argc, char **argv)
+{
+  size_t i;
+  int option;
+
+  while ((option = getopt(argc, argv, "r:")) != -1)
+  {
+    if (option == 'r')
+      rounds = atoi(optarg);
+    else
+    {
+      fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rounds < 1)
+  {
+    fprintf(stderr, "%s: bad round count\n", argv[0]);
+    return 2;
+  }
+
+#if USE_RTOS
+  qidMain = osMessageQueueNew(UARTBENCH_QUEUE, sizeof(MsgObj), NULL);
+#endif
+  SetupController();
+
+  printf("%u frames from c, d and e per round, %d rounds per row\n",
+         (unsigned)(sizeof(frames) / sizeof(frames[0])), rounds);
+  printf("%-6s %-7s %10s %11s %8s %9s %9s %9s\n", "level", "line", "irq/frame", "bytes/irq",
+         "rt %", "ns/byte", "max ns", "overruns");
+  for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+  {
+    Row(&levels[i], false);
+  }
+  for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++)
+  {
+    Row(&levels[i], true);
+  }
+  return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *      Bench Functions
+ *---------------------------------------------------------------------------*/
+
+static void Row(const LevelObj *level, bool spaced)
+{
+  ProbeObj reset = {0, 0xFFFFFFFFU, 0, 0, 0};
+  uint32_t overruns = hostUart[0].Overruns;
+  uint32_t frameCount;
+  uint32_t byteCount;
+  int round;
+
+  UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX4_8, level->Level);
+  probeUart = reset;
+  countFrames = 0;
+  countBytes = 0;
+  countTimeouts = 0;
+  countOverflows = 0;
+
+  for (round = 0; round < rounds; round++)
+  {
+    Feed(spaced);
+  }
+
+  frameCount = countFrames ? countFrames : 1;
+  byteCount = countBytes ? countBytes : 1;
+  printf("%-6s %-7s %10.2f %11.2f %7.1f%% %9.1f %9u %9u\n", level->Name, spaced ? "spaced" : "burst",
+         (double)probeUart.Count / frameCount, (double)countBytes / (probeUart.Count ? probeUart.Count : 1),
+         100.0 * countTimeouts / (probeUart.Count ? probeUart.Count : 1), (double)probeUart.Total / byteCount,
+         probeUart.Max, hostUart[0].Overruns - overruns + countOverflows);
+}
+
+// One round of every frame, the frames queued by the ISR are dropped so that
+// only the receive path is timed
+static void Feed(bool spaced)
+{
+  char stream[64];
+  int size = 0;
+  int length;
+  size_t i;
+
+  for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++)
+  {
+    length = (int)strlen(frames[i]);
+    if (spaced)
+    {
+      HostReceive(UART0_BASE, frames[i], length);
+    }
+    else
+    {
+      memcpy(stream + size, frames[i], (size_t)length);
+      size += length;
+    }
+  }
+  if (!spaced)
+  {
+    HostReceive(UART0_BASE, stream, size);
+  }
+
+#if USE_RTOS
+  osMessageQueueReset(qidMain);
+#else
+  ringMain.Tail = ringMain.Head;
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO // records above this level are not compiled in
+#endif
+
+typedef enum {                                  // log token data type, same order as logFormats
+  LOG_CALL,
+  LOG_COLLAPSED,
+  LOG_STOP,
+  LOG_CLOSE_FAILED,
+  LOG_REASSIGN,
+  LOG_COLD_START,
+  LOG_TIMING_SAVED,
+  LOG_EVACUATION,
+  LOG_OUT_OF_SERVICE,
+  LOG_IN_SERVICE,
+  LOG_TOKENS
+} LogToken;
+
+typedef struct {                                // log record data type
+  uint32_t Time;
+  uint16_t Token;
+  uint16_t Level;
+  uint32_t Args[2];
+} LogObj;
+
+void LogWrite(uint16_t level, uint16_t token, uint32_t arg0, uint32_t arg1);
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(token, arg0, arg1) LogWrite(LOG_LEVEL_ERROR, token, (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define LOG_ERROR(token, arg0, arg1) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(token, arg0, arg1) LogWrite(LOG_LEVEL_WARN, token, (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define LOG_WARN(token, arg0, arg1) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(token, arg0, arg1) LogWrite(LOG_LEVEL_INFO, token, (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define LOG_INFO(token, arg0, arg1) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(token, arg0, arg1) LogWrite(LOG_LEVEL_DEBUG, token, (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define LOG_DEBUG(token, arg0, arg1) ((void)0)
+#endif
+
+#endif
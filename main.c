@@ -3,6 +3,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <stddef.h>
+#include <assert.h>
 
 #include "inc/hw_ints.h"
 #include "inc/hw_memmap.h"
@@ -10,13 +12,85 @@
 #include "driverlib/sysctl.h"
 #include "driverlib/uart.h"
 #include "driverlib/interrupt.h"
+#include "driverlib/gpio.h"
+#include "driverlib/pin_map.h"
+#include "driverlib/eeprom.h"
+#include "driverlib/systick.h"
 
-#include "cmsis_os2.h" // CMSIS-RTOS
+#if !defined(USE_RTOS) || USE_RTOS
+#include "cmsis_os2.h" // CMSIS-RTOS, not part of the bare-metal target
+#endif
+#include "TM4C129.h"   // Device header
 
 #include "UART.h"
 #include "misc.h"
+#include "profile.h"
+#include "log.h"
 
+#define CAPTURE_OBJECTS 128 // number of Capture Objects in the RAM ring
+#define STATE_SLOTS 32      // EEPROM slots the state record rotates over
+#define LOG_OBJECTS 64      // number of Log Objects in the RAM ring
+#define LOG_PERIOD 50       // ms between two expansions of the log ring
+#define LOG_LINE 64         // characters of one expanded log record
+
+#ifndef USE_RTOS
+#define USE_RTOS 1          // 0 builds the bare-metal event loop instead of RTX
+#endif
+#define CAPTURE_MODE 1      // record every received and transmitted frame
+#ifndef PIPELINE_MODE
+#define PIPELINE_MODE 1     // release the move from the receive path on 'F'
+#endif
+#define WARM_RESTART 1      // resume from the EEPROM state instead of 'r'
+#define TELEMETRY_MODE 1    // stream car state changes on the spare UART1
+
+// Tuning parameters, each one can be overridden from the compiler command
+// line (-D) so strategies and settings can be swept without editing the code
+#ifndef MSGQUEUE_OBJECTS
 #define MSGQUEUE_OBJECTS 16 // number of Message Queue Objects
+#endif
+#ifndef OPERATING_MODE
+#define OPERATING_MODE NORMAL_MODE // NORMAL_MODE or DESTINATION_MODE
+#endif
+#ifndef REOPTIMIZE_PERIOD
+#define REOPTIMIZE_PERIOD 500     // ms between re-optimization passes
+#endif
+#ifndef REOPTIMIZE_THRESHOLD
+#define REOPTIMIZE_THRESHOLD 20   // cost that a new plan must save, in s^2
+#endif
+#ifndef FLOOR_TIME
+#define FLOOR_TIME 1500           // initial ms to travel one floor
+#endif
+#ifndef START_TIME
+#define START_TIME 1000           // initial ms of start and stop overhead
+#endif
+#ifndef OPEN_TIME
+#define OPEN_TIME 2000            // initial ms to open the door
+#endif
+#ifndef CLOSE_TIME
+#define CLOSE_TIME 2000           // initial ms to close the door
+#endif
+
+#ifndef CONTROLLER_ID
+#define CONTROLLER_ID 1           // identifies this controller on the telemetry
+#endif
+#ifndef TELEMETRY_ANNOUNCE_PERIODS
+#define TELEMETRY_ANNOUNCE_PERIODS 100 // telemetry periods between two announces
+#endif
+#ifndef TELEMETRY_PERIOD
+#define TELEMETRY_PERIOD 100      // ms between two telemetry records at most
+#endif
+#ifndef UART_RX_LEVEL
+#define UART_RX_LEVEL UART_FIFO_RX4_8 // UART0 receive FIFO fill that raises RX, RT covers the rest
+#endif
+#ifndef HEALTH_TIMEOUT
+#define HEALTH_TIMEOUT 5000       // ms a busy car may stay silent, above any floor or door move
+#endif
+
+#define WAIT_LIMIT 4095           // s, keeps 16 squared waits inside 32 bits
+
+#define TIMING_SAVE_SAMPLES 32    // samples learned between two EEPROM writes
+#define TIMING_ADDRESS (STATE_SLOTS * sizeof(StateObj)) // EEPROM timing model
+#define SPARE_BAUD 115200   // baud rate of the spare UART1
 
 /*----------------------------------------------------------------------------
  *      Declare Functions
@@ -25,6 +99,13 @@
 // Thread Functions
 void ThreadMain(void *argument);
 void ThreadCentral(void *argument);
+void InitCentral(ElevatorObj *central);
+
+// Event Loop Functions
+void EventLoop(void);
+void SysTickHandler(void);
+bool RingPut(RingObj *ring, MsgObj *msg);
+bool RingGet(RingObj *ring, MsgObj *msg);
 
 // Elevator Functions
 void InitElevator(char elevator);
@@ -34,46 +115,230 @@ void StopElevator(char elevator);
 void MovElevator(char elevator, char direction);
 void MovCommand(char* command, char actualFloor, char* targetFloor);
 void SetMovement(char elevator, char actualFloor, char targetFloor);
+void DoorSent(DoorObj *door, char status);
+bool DoorAcked(DoorObj *door, char ack);
+bool DoorClosing(DoorObj *door);
+void ResetDoors(void);
+
+// Decision Functions
+void CentralCommand(ElevatorObj *elevator, MsgObj *msg);
+void CentralResponse(ElevatorObj *elevator, MsgObj *msg);
+void CentralArrival(ElevatorObj *elevator);
+char NextStop(ElevatorObj *elevator);
+void CloseAndMove(ElevatorObj *elevator);
+void TurnMove(ElevatorObj *elevator);
+char MoveDirection(ElevatorObj *elevator);
+
+// Evacuation Functions
+void ApplyMode(ElevatorObj *elevator);
+char EvacuationStop(ElevatorObj *elevator);
+uint32_t EvacuationTime(uint16_t occupied, char fromFloor);
+
+// Health Functions
+void CentralHealth(ElevatorObj *elevator);
+void CentralRestore(ElevatorObj *elevator, MsgObj *msg);
+uint32_t HomingTimeout(void);
+
+// Reoptimize Functions
+void ReoptimizeTimer(void *argument);
+void Reoptimize(ElevatorObj *elevator);
+uint32_t PlanCost(ElevatorObj *elevator, char direction);
+int PlanWaits(ElevatorObj *elevator, char direction, WaitsObj *waits);
+uint32_t SumSquares(WaitsObj *waits, int count);
+
+// Timing Functions
+void LearnFloor(char floor, uint32_t time);
+void LearnDoor(char door, uint32_t time);
+void LearnAverage(uint32_t *average, uint32_t sample);
+uint32_t EstimateTravel(char fromFloor, char toFloor);
+uint32_t EstimateStop(void);
+bool LoadTiming(void);
+void SaveTiming(void);
+uint32_t TimingCheck(TimingObj *model);
+
+// Ingress Functions
+bool AcceptCall(MsgObj *msg);
+void ClearCall(char elevator, char floor);
+void DropCall(MsgObj *msg);
+void RebuildCalls(ElevatorObj *elevator);
+
+// Snapshot Functions
+void PublishSnapshot(ElevatorObj *elevator);
+void ReadSnapshot(SnapshotObj *snapshot);
+
+// Telemetry Functions
+void TelemetryTimer(void *argument);
+void TelemetryFlush(void);
+void TelemetrySend(uint8_t *record, int size);
+int TelemetryEncode(uint8_t *record, int size, uint8_t *frame);
+int CobsEncode(const uint8_t *data, int size, uint8_t *frame);
+uint16_t Crc16(const uint8_t *data, int size);
+
+// Pipeline Functions
+void PipelineFrame(MsgObj *msg);
+void PipelineLatency(void);
+
+// State Functions
+bool SetupEeprom(void);
+bool LoadState(void);
+void SaveState(ElevatorObj *elevator);
+void RestoreState(ElevatorObj *elevator);
+bool CheckWarmStart(ElevatorObj *elevator, char reportedFloor);
+uint16_t StateCheck(StateObj *state);
+
+// Log Functions
+void ThreadLog(void *argument);
+void LogExpand(void);
+void LogOutput(char *text, int size);
+int stdout_putchar(int ch);
+
+// Capture Functions
+void CaptureFrame(char direction, const char *command, int size);
+void DumpCapture(void);
+void ReplayCapture(bool realTime);
+void ReplayStep(void);
+void PollSpareUart(void);
 
 // Aux Functions
+void SetupController(void);
+uint32_t GetTicks(void);
+bool IsCommandFrame(MsgObj *msg);
+bool IsModeFrame(MsgObj *msg);
 void SetupUart(void);
+void SetupSpareUart(void);
 void UARTIntHandler(void);
+void ReceiveFrame(MsgObj *msg, uint32_t timeout);
+void SendFrame(const char *command, int size);
 char GetFloorCharFromFloorNumberString(char floorNumber, char isHigher);
+char GetFloorCharFromCommand(MsgObj *msg);
 
 /*----------------------------------------------------------------------------
  *      Global Variables
  *---------------------------------------------------------------------------*/
 MsgObj uartMsg;
+#if USE_RTOS
 osThreadId_t tidMain;
 osThreadId_t tidCentral;
+osThreadId_t tidLog;
 osMessageQueueId_t qidMain;
 osMessageQueueId_t qidCentralCommands;
 osMessageQueueId_t qidCentralResponses;
+osTimerId_t timReoptimize;
+osTimerId_t timTelemetry;
+const osThreadAttr_t logThreadAttr = {"ThreadLog", 0, NULL, 0, NULL, 0, osPriorityLow, 0, 0};
+#else
+RingObj ringMain;
+RingObj ringCentralCommands;
+RingObj ringCentralResponses;
+volatile uint32_t ticks; // SysTick count in ms for the bare-metal build
+#endif
+const char *logFormats[LOG_TOKENS] = {   // indexed by LogToken
+  "call %c floor %c\n",
+  "call %c floor %c collapsed\n",
+  "stop %c floor %c\n",
+  "close failed %c, move %c dropped\n",
+  "reassign target %c to %c\n",
+  "cold start, reported floor %c stored %c\n",
+  "timing saved floor %u ms samples %u\n",
+  "evacuation of %u floors estimated in %u s\n",
+  "car %c out of service at floor %c\n",
+  "car %c back in service after %u ms\n",
+};
+LogObj logRing[LOG_OBJECTS];
+volatile uint32_t logHead;       // next record to write
+volatile uint32_t logTail;       // next record to expand
+uint32_t logDropped;             // records lost because the ring was full
+MsgObj reoptimizeMsg = {{CENTRAL_ELEVATOR, REOPTIMIZE}, 2};
+uint32_t reassignCount;  // times a re-optimization changed the plan
+volatile char modeRequest; // mode asked by the last fire panel frame, 0 if none
+volatile uint32_t healthTime[ELEVATORS]; // tick of the last floor report or ack of each car
+bool healthWatched[ELEVATORS];           // busy car whose silence is being timed
+volatile bool healthHoming[ELEVATORS];   // reset car homing, silent until its first floor report
+uint32_t homingTime[ELEVATORS];          // tick the reset was sent
+bool outOfService[ELEVATORS];            // car stopped answering while busy
+uint32_t outageStart[ELEVATORS];         // tick the car was taken out of service
+uint32_t outageTime[ELEVATORS];          // total ms spent out of service
+uint32_t outages[ELEVATORS];             // times the car was taken out of service
+TimingObj timing = {FLOOR_TIME, START_TIME, OPEN_TIME, CLOSE_TIME, 0, 0};
+uint32_t timingDoorTime;  // tick the last door command was sent
+uint32_t timingRunTime;   // tick of the 'F' ack that started the run
+uint32_t timingFloorTime; // tick of the last floor report of the run, 0 if none
+char timingFloor;         // floor of that report
+bool eepromReady;
+volatile uint16_t pendingCalls[ELEVATORS]; // floors with a call already queued
+uint32_t collapsedCalls[ELEVATORS];         // repeated presses dropped on ingress
+uint32_t rejectedCalls;                     // button frames for no floor, dropped on ingress
+LatchObj centralLatch;           // central car state for readers outside ThreadCentral
+uint32_t snapshotRetries;        // reads that overlapped a publish and retried
+SnapshotObj telemetrySent;       // car state of the last telemetry record
+uint32_t telemetryRecords;       // records sent on UART1
+uint32_t telemetryBytes;         // bytes sent on UART1
+uint32_t telemetryDropped;       // bytes the UART1 FIFO had no room for
+uint32_t telemetryFlushes;       // telemetry periods elapsed
+uint8_t telemetrySequence;       // sequence of the next record
+bool telemetryResync;            // last frame was cut short, open the next with a delimiter
+volatile bool telemetryHeld;     // a capture dump owns UART1 until it ends
+CaptureObj capture[CAPTURE_OBJECTS];
+uint32_t captureCount;
+ReplayObj replay;                // capture replay in progress, started from UART1
+uint32_t centralCalls; // calls accepted by the central elevator
+uint32_t centralStops; // stops made by the central elevator
+uint32_t centralTrips; // runs from idle back to idle of the central elevator
+volatile char pipelineMove;     // move armed behind the door close, 0 if none
+volatile bool pipelineReleased; // the armed move was sent by the receive path
+DoorObj doorCentral;            // door commands ThreadCentral has not seen acked
+DoorObj doorPipeline;           // door commands the receive path has not seen acked
+StateObj savedState;    // last record written to or read from the EEPROM
+uint32_t stateSlot;      // EEPROM slot of savedState
+bool warmStart;          // booted from a valid state record, not checked yet
+PROBE(probeUart);        // UARTIntHandler, its count is the number of interrupts
+PROBE(probeCentral);     // one decision step of ThreadCentral
+PROBE(probeSend);        // one encoded frame sent by SendFrame
+PROBE(probeCloseToMove); // door-closed-to-motion latency
+PROBE(probePlan);        // scoring both sweep plans of a re-optimization
+COUNTER(countFrames);    // frames received by UARTIntHandler
+COUNTER(countBytes);     // bytes drained from the UART0 FIFO
+COUNTER(countTimeouts);  // interrupts raised by the receive timeout
+COUNTER(countOverflows); // frames dropped for not fitting in a MsgObj
 
 /*----------------------------------------------------------------------------
  *      Main Function
  *---------------------------------------------------------------------------*/
 int main(void)
 {
+#if USE_RTOS
   osKernelInitialize(); // Initialize CMSIS-RTOS
+  PROFILE_INIT();       // Start the cycle counter
 
   // Set threads, queues and mutex
   tidMain = osThreadNew(ThreadMain, NULL, NULL);
   tidCentral = osThreadNew(ThreadCentral, NULL, NULL);
+  tidLog = osThreadNew(ThreadLog, NULL, &logThreadAttr);
 
   qidMain = osMessageQueueNew(MSGQUEUE_OBJECTS, sizeof(MsgObj), NULL);
   qidCentralCommands = osMessageQueueNew(MSGQUEUE_OBJECTS, sizeof(MsgObj), NULL);
 	qidCentralResponses = osMessageQueueNew(MSGQUEUE_OBJECTS, sizeof(MsgObj), NULL);
+
+  timReoptimize = osTimerNew(ReoptimizeTimer, osTimerPeriodic, NULL, NULL);
+  osTimerStart(timReoptimize, REOPTIMIZE_PERIOD);
+
+#if TELEMETRY_MODE
+  timTelemetry = osTimerNew(TelemetryTimer, osTimerPeriodic, NULL, NULL);
+  osTimerStart(timTelemetry, TELEMETRY_PERIOD);
+#endif
 	
   if (osKernelGetState() == osKernelReady)
   {
-    IntMasterEnable(); // Enable interruptions
-    SetupUart();       // Set UART configuration
-		
-		InitElevator(CENTRAL_ELEVATOR);
+    SetupController();
 
     osKernelStart(); // Start thread execution
   }
+#else
+  PROFILE_INIT();       // Start the cycle counter
+  SetupController();
+
+  EventLoop();          // Run the controller without RTOS
+#endif
 
   while (1){};
 }
@@ -81,6 +346,7 @@ int main(void)
 /*----------------------------------------------------------------------------
  *      Threads Functions
  *---------------------------------------------------------------------------*/
+#if USE_RTOS
 
 void ThreadMain(void *argument)
 {
@@ -94,9 +360,18 @@ void ThreadMain(void *argument)
     {
       if(msg.Command[0] == 'c')
 			{
-				if(msg.Size > 2)
+				if(IsModeFrame(&msg))
+				{
+					// Wake ThreadCentral whichever queue it is waiting on
+					osMessageQueuePut(qidCentralCommands, &msg, 0U, 0U);
+					osMessageQueuePut(qidCentralResponses, &msg, 0U, 0U);
+				}
+				else if(IsCommandFrame(&msg))
 				{
-					osMessageQueuePut(qidCentralCommands, &msg, 0U, 100U);
+					if(osMessageQueuePut(qidCentralCommands, &msg, 0U, 100U) != osOK)
+					{
+						DropCall(&msg);
+					}
 				}
 				else
 				{
@@ -107,112 +382,556 @@ void ThreadMain(void *argument)
   }
 }
 
-/*----------------------------------------------------------------------------
- *      Elevator Functions
- *---------------------------------------------------------------------------*/
 void ThreadCentral(void *argument)
 {
   osStatus_t statusCommand;
 	osStatus_t statusResponse;
   MsgObj commandMsg;
 	MsgObj responseMsg;
-	char elevatorStatus = READY;
-	char actualFloor = FLOOR_0;
-  char targetFloor = FLOOR_0;
+	ElevatorObj central;
 
-	
+	InitCentral(&central);
 
   while (1)
   {
-		if(elevatorStatus == READY)
+		if(central.Status == READY)
 		{
 			statusCommand = osMessageQueueGet(qidCentralCommands, &commandMsg, NULL, osWaitForever);
 			if(statusCommand == osOK)
 			{
-				elevatorStatus = BUSY;
-				if (commandMsg.Size == 3)
-				{
-					targetFloor = commandMsg.Command[2];
-				}
-				else if (commandMsg.Size == 5)
-				{
-					targetFloor = GetFloorCharFromFloorNumberString(commandMsg.Command[3], commandMsg.Command[2]);
-				}
+				PROFILE_BEGIN(probeCentral);
+				CentralCommand(&central, &commandMsg);
+				PROFILE_END(probeCentral);
 			}
-
-			ChangeButtonStatus(commandMsg.Command[0], targetFloor, ON);
-			ChangeDoorStatus(commandMsg.Command[0], CLOSED);
 		}
-		else if(elevatorStatus == BUSY)
+		else if(central.Status == BUSY)
 		{
-			statusResponse = osMessageQueueGet(qidCentralResponses, &responseMsg, NULL, osWaitForever);
+			// Bounded wait, a car that stops answering must not hold its calls
+			statusResponse = osMessageQueueGet(qidCentralResponses, &responseMsg, NULL, HEALTH_TIMEOUT);
 			if(statusResponse == osOK)
 			{
-				if(responseMsg.Command[1] != 'A' && responseMsg.Command[1] != 'F')
-				{
-					if(responseMsg.Size == 2)
-					{
-						actualFloor = GetFloorCharFromFloorNumberString(responseMsg.Command[1], '0');
-					}
-					else if(responseMsg.Size == 3)
-					{
-						actualFloor = GetFloorCharFromFloorNumberString(responseMsg.Command[2], responseMsg.Command[1]);
-					}
-				}
-				else
+				PROFILE_BEGIN(probeCentral);
+				CentralResponse(&central, &responseMsg);
+				PROFILE_END(probeCentral);
+			}
+
+			// In destination mode new calls join the running sweep, in evacuation
+			// hall calls mark their floor while the car shuttles
+			if(central.Mode == DESTINATION_MODE || central.Mode == EVACUATION_MODE)
+			{
+				while(osMessageQueueGet(qidCentralCommands, &commandMsg, NULL, 0U) == osOK)
 				{
-					if(responseMsg.Command[1] == 'F')
-					{
-						SetMovement(responseMsg.Command[0], actualFloor, targetFloor);
-					}
+					CentralCommand(&central, &commandMsg);
 				}
 			}
 		}
 		
-		if(actualFloor == targetFloor)
+		CentralArrival(&central);
+		CentralHealth(&central);
+#if WARM_RESTART
+		SaveState(&central);
+#endif
+		PublishSnapshot(&central);
+  }
+}
+#endif
+
+void InitCentral(ElevatorObj *central)
+{
+	ElevatorObj initial = {CENTRAL_ELEVATOR, READY, FLOOR_0, FLOOR_0, STOP, OPEN, OPERATING_MODE, 0};
+
+	*central = initial;
+	if(warmStart)
+	{
+		RestoreState(central);
+
+		// Calls already known to the car are not forwarded again
+		RebuildCalls(central);
+	}
+}
+
+/*----------------------------------------------------------------------------
+ *      Event Loop Functions
+ *---------------------------------------------------------------------------*/
+#if !USE_RTOS
+
+// Same steps as ThreadMain and ThreadCentral, run to completion from one loop
+// fed by the UART ISR, sleeping until the next interrupt when idle
+void EventLoop()
+{
+  ElevatorObj central;
+  MsgObj msg;
+  uint32_t reoptimizeTime = 0;
+  uint32_t telemetryTime = 0;
+
+  InitCentral(&central);
+
+  while (1)
+  {
+#if TELEMETRY_MODE
+    if (GetTicks() - telemetryTime >= TELEMETRY_PERIOD)
+    {
+      telemetryTime = GetTicks();
+      TelemetryFlush();
+    }
+#endif
+    if (GetTicks() - reoptimizeTime >= REOPTIMIZE_PERIOD)
+    {
+      reoptimizeTime = GetTicks();
+      if (ringCentralResponses.Head == ringCentralResponses.Tail)
+      {
+        RingPut(&ringCentralResponses, &reoptimizeMsg);
+      }
+    }
+
+    while (RingGet(&ringMain, &msg))
+    {
+      if (msg.Command[0] == 'c' && IsModeFrame(&msg))
+      {
+        RingPut(&ringCentralCommands, &msg);
+        RingPut(&ringCentralResponses, &msg);
+      }
+      else if (msg.Command[0] == 'c' && IsCommandFrame(&msg))
+      {
+        if (!RingPut(&ringCentralCommands, &msg))
+        {
+          DropCall(&msg);
+        }
+      }
+      else if (msg.Command[0] == 'c')
+      {
+        RingPut(&ringCentralResponses, &msg);
+      }
+    }
+
+    if (central.Status == READY && RingGet(&ringCentralCommands, &msg))
+    {
+      PROFILE_BEGIN(probeCentral);
+      CentralCommand(&central, &msg);
+      PROFILE_END(probeCentral);
+    }
+    else if (central.Status == BUSY && RingGet(&ringCentralResponses, &msg))
+    {
+      PROFILE_BEGIN(probeCentral);
+      CentralResponse(&central, &msg);
+      PROFILE_END(probeCentral);
+
+      if (central.Mode == DESTINATION_MODE || central.Mode == EVACUATION_MODE)
+      {
+        while (RingGet(&ringCentralCommands, &msg))
+        {
+          CentralCommand(&central, &msg);
+        }
+      }
+    }
+    else
+    {
+      CentralHealth(&central);
+      PollSpareUart();
+      ReplayStep();
+      LogExpand();
+
+      // The 1 ms SysTick bounds the wait for a frame queued just before this
+      __WFI();
+      continue;
+    }
+
+    CentralArrival(&central);
+    CentralHealth(&central);
+#if WARM_RESTART
+    SaveState(&central);
+#endif
+    PublishSnapshot(&central);
+  }
+}
+
+void SysTickHandler()
+{
+  ticks++;
+}
+
+#endif
+
+// Single producer, single consumer ring of frames
+bool RingPut(RingObj *ring, MsgObj *msg)
+{
+  uint32_t head = ring->Head;
+
+  if (head - ring->Tail >= RING_OBJECTS)
+  {
+    return false;
+  }
+  ring->Msg[head % RING_OBJECTS] = *msg;
+  ring->Head = head + 1;
+  return true;
+}
+
+bool RingGet(RingObj *ring, MsgObj *msg)
+{
+  uint32_t tail = ring->Tail;
+
+  if (ring->Head == tail)
+  {
+    return false;
+  }
+  *msg = ring->Msg[tail % RING_OBJECTS];
+  ring->Tail = tail + 1;
+  return true;
+}
+
+/*----------------------------------------------------------------------------
+ *      Decision Functions
+ *---------------------------------------------------------------------------*/
+
+// Decision steps of ThreadCentral, kept free of queue calls so each one can
+// be driven and timed on its own
+void CentralCommand(ElevatorObj *elevator, MsgObj *msg)
+{
+	char floor = GetFloorCharFromCommand(msg);
+	bool masked;
+
+	if(IsModeFrame(msg))
+	{
+		ApplyMode(elevator);
+		return;
+	}
+
+	// A floor outside the building has no stop bit to set
+	if(floor < FLOOR_0 || floor > FLOOR_15)
+	{
+		return;
+	}
+
+	centralCalls++;
+	LOG_INFO(LOG_CALL, elevator->Elevator, floor);
+
+	if(elevator->Mode == EVACUATION_MODE)
+	{
+		// Car calls are skipped and released on ingress, a hall call marks
+		// the floor as occupied
+		if(msg->Command[1] == EXTERNAL_BUTTON)
 		{
-			elevatorStatus = READY;
-			StopElevator(CENTRAL_ELEVATOR);
-			ChangeButtonStatus(CENTRAL_ELEVATOR, actualFloor, OFF);
-			ChangeDoorStatus(CENTRAL_ELEVATOR, OPEN);
+			elevator->Stops |= FLOOR_BIT(floor);
 		}
-  }
+		else
+		{
+			ClearCall(elevator->Elevator, floor);
+		}
+		if(elevator->Status == READY && elevator->Stops)
+		{
+			elevator->Status = BUSY;
+			elevator->TargetFloor = EvacuationStop(elevator);
+			CloseAndMove(elevator);
+		}
+		return;
+	}
+
+	if(elevator->Status == READY)
+	{
+		centralTrips++;
+	}
+
+	if(elevator->Mode == DESTINATION_MODE)
+	{
+		// Passengers for the same floor share one stop, the lit hall button
+		// tells them this car was assigned
+		if(!(elevator->Stops & FLOOR_BIT(floor)))
+		{
+			elevator->Stops |= FLOOR_BIT(floor);
+			elevator->CallTime[floor - FLOOR_0] = GetTicks();
+			ChangeButtonStatus(elevator->Elevator, floor, ON);
+		}
+
+		if(elevator->Status == READY)
+		{
+			elevator->Status = BUSY;
+			elevator->TargetFloor = NextStop(elevator);
+			if(elevator->TargetFloor != elevator->ActualFloor)
+			{
+				CloseAndMove(elevator);
+			}
+		}
+		else
+		{
+			elevator->TargetFloor = NextStop(elevator);
+
+			// Re-arm a move still waiting for the ack, unless the receive path
+			// has already sent it
+			masked = IntMasterDisable();
+			if(pipelineMove)
+			{
+				pipelineMove = MoveDirection(elevator);
+			}
+			if(!masked)
+			{
+				IntMasterEnable();
+			}
+		}
+		return;
+	}
+
+	elevator->Status = BUSY;
+	elevator->TargetFloor = floor;
+
+	ChangeButtonStatus(msg->Command[0], elevator->TargetFloor, ON);
+	CloseAndMove(elevator);
+}
+
+void CentralResponse(ElevatorObj *elevator, MsgObj *msg)
+{
+	char floor = elevator->ActualFloor;
+
+	if(msg->Command[1] == REOPTIMIZE)
+	{
+		Reoptimize(elevator);
+		return;
+	}
+	if(IsModeFrame(msg))
+	{
+		ApplyMode(elevator);
+		return;
+	}
+	if(msg->Command[1] != OPEN_ACK && msg->Command[1] != CLOSED_ACK)
+	{
+		if(msg->Size == 2)
+		{
+			floor = GetFloorCharFromFloorNumberString(msg->Command[1], '0');
+		}
+		else if(msg->Size == 3)
+		{
+			floor = GetFloorCharFromFloorNumberString(msg->Command[2], msg->Command[1]);
+		}
+
+		// A stale record sends the car home, it is no longer where it reported
+		if(warmStart && CheckWarmStart(elevator, floor))
+		{
+			return;
+		}
+		LearnFloor(floor, msg->Time);
+		elevator->ActualFloor = floor;
+	}
+	else
+	{
+		elevator->Door = (msg->Command[1] == OPEN_ACK) ? OPEN : CLOSED;
+		DoorAcked(&doorCentral, msg->Command[1]);
+		LearnDoor(msg->Command[1], msg->Time);
+
+		// The door is open but the car still has somewhere to go, either after
+		// a stop of the sweep or because the close failed: close it again. An
+		// 'A' left from an earlier OPEN while a close is on its way is not one
+		if(msg->Command[1] == OPEN_ACK && elevator->Status == BUSY && elevator->TargetFloor != elevator->ActualFloor
+		   && !DoorClosing(&doorCentral))
+		{
+			CloseAndMove(elevator);
+		}
+
+		if(msg->Command[1] == CLOSED_ACK)
+		{
+			// With the pipeline the move already left from the receive path
+			if(pipelineReleased)
+			{
+				pipelineReleased = false;
+			}
+			else
+			{
+				SetMovement(msg->Command[0], elevator->ActualFloor, elevator->TargetFloor);
+				PipelineLatency();
+			}
+			if(elevator->TargetFloor > elevator->ActualFloor)
+			{
+				elevator->Direction = UP;
+			}
+			else if(elevator->TargetFloor < elevator->ActualFloor)
+			{
+				elevator->Direction = DOWN;
+			}
+		}
+	}
+
+	// Checked last, once the frame has moved the car state on
+	if(outOfService[ELEVATOR_INDEX(elevator->Elevator)])
+	{
+		CentralRestore(elevator, msg);
+	}
+}
+
+void CentralArrival(ElevatorObj *elevator)
+{
+	if(elevator->ActualFloor == elevator->TargetFloor)
+	{
+		centralStops++;
+		LOG_INFO(LOG_STOP, elevator->Elevator, elevator->ActualFloor);
+		elevator->Status = READY;
+		ClearCall(elevator->Elevator, elevator->ActualFloor);
+		StopElevator(elevator->Elevator);
+		ChangeButtonStatus(elevator->Elevator, elevator->ActualFloor, OFF);
+		ChangeDoorStatus(elevator->Elevator, OPEN);
+		timingDoorTime = GetTicks();
+
+		if(elevator->Mode == DESTINATION_MODE)
+		{
+			elevator->Stops &= ~FLOOR_BIT(elevator->ActualFloor);
+			if(elevator->Stops)
+			{
+				// The door closes again once its 'A' ack arrives
+				elevator->Status = BUSY;
+				elevator->TargetFloor = NextStop(elevator);
+			}
+			else
+			{
+				elevator->Direction = STOP;
+			}
+		}
+		else if(elevator->Mode == EVACUATION_MODE)
+		{
+			elevator->Stops &= ~FLOOR_BIT(elevator->ActualFloor);
+			if(elevator->Stops || elevator->ActualFloor != EXIT_FLOOR)
+			{
+				elevator->Status = BUSY;
+				elevator->TargetFloor = EvacuationStop(elevator);
+			}
+		}
+	}
+}
+
+// Close the door and, with the pipeline, arm the move so it is sent as soon as
+// the 'F' ack is received instead of after the round trip through the threads
+void CloseAndMove(ElevatorObj *elevator)
+{
+#if PIPELINE_MODE
+	pipelineMove = MoveDirection(elevator);
+#endif
+	PROFILE_BEGIN(probeCloseToMove);
+	ChangeDoorStatus(elevator->Elevator, CLOSED);
+	timingDoorTime = GetTicks();
+}
+
+// New target for a car already committed to a move. Still waiting for the
+// 'F', re-arm the move. Already moving, turn now: that includes a move the
+// receive path released on an 'F' that ThreadCentral has not seen yet, when
+// the door still reads OPEN here
+void TurnMove(ElevatorObj *elevator)
+{
+	bool masked = IntMasterDisable();
+
+	if(pipelineMove)
+	{
+		pipelineMove = MoveDirection(elevator);
+	}
+	else if(pipelineReleased || elevator->Door == CLOSED)
+	{
+		SetMovement(elevator->Elevator, elevator->ActualFloor, elevator->TargetFloor);
+	}
+	if(!masked)
+	{
+		IntMasterEnable();
+	}
+}
+
+// Move needed to reach the target, 0 when the car is already there
+char MoveDirection(ElevatorObj *elevator)
+{
+	if(elevator->TargetFloor > elevator->ActualFloor)
+	{
+		return UP;
+	}
+	else if(elevator->TargetFloor < elevator->ActualFloor)
+	{
+		return DOWN;
+	}
+	return 0;
+}
+
+// Next floor of the sweep: the nearest pending stop ahead in the current
+// direction, reversing only when nothing is left ahead. A car already
+// committed to another floor has left the one it last reported or is
+// closing to leave it, so a call there waits for the sweep to come back
+char NextStop(ElevatorObj *elevator)
+{
+	int actual = elevator->ActualFloor - FLOOR_0;
+	int floor;
+
+	if((elevator->Stops & FLOOR_BIT(elevator->ActualFloor)) && elevator->TargetFloor == elevator->ActualFloor)
+	{
+		return elevator->ActualFloor;
+	}
+
+	if(elevator->Direction != DOWN)
+	{
+		for(floor = actual + 1; floor < FLOORS; floor++)
+		{
+			if(elevator->Stops & (1U << floor))
+				return FLOOR_0 + floor;
+		}
+	}
+	for(floor = actual - 1; floor >= 0; floor--)
+	{
+		if(elevator->Stops & (1U << floor))
+			return FLOOR_0 + floor;
+	}
+	for(floor = actual + 1; floor < FLOORS; floor++)
+	{
+		if(elevator->Stops & (1U << floor))
+			return FLOOR_0 + floor;
+	}
+
+	return elevator->ActualFloor;
 }
 
+/*----------------------------------------------------------------------------
+ *      Elevator Functions
+ *---------------------------------------------------------------------------*/
+// Homing reports no floors, so the car's health is not timed until it is
+// back or a run from the top floor is over
 void InitElevator(char elevator)
 {
-  UART_OutChar(elevator);
-  UART_OutChar(INIT_ELEVATOR);
-  UART_OutChar(END_COMMAND);
+  char command[2] = {elevator, INIT_ELEVATOR};
+  int index = ELEVATOR_INDEX(elevator);
+
+  healthWatched[index] = false;
+  homingTime[index] = GetTicks();
+  healthHoming[index] = true;
+  SendFrame(command, 2);
+  if (elevator == CENTRAL_ELEVATOR)
+  {
+    ResetDoors();
+  }
 }
 
 void ChangeDoorStatus(char elevator, char status)
 {
-  UART_OutChar(elevator);
-  UART_OutChar(status);
-  UART_OutChar(END_COMMAND);
+  char command[2] = {elevator, status};
+  bool masked;
+
+  SendFrame(command, 2);
+  if (elevator == CENTRAL_ELEVATOR)
+  {
+    masked = IntMasterDisable();
+    DoorSent(&doorCentral, status);
+    DoorSent(&doorPipeline, status);
+    if (!masked)
+    {
+      IntMasterEnable();
+    }
+  }
 }
 
 void ChangeButtonStatus(char elevator, char floor, char status)
 {
-  UART_OutChar(elevator);
-  UART_OutChar(status);
-  UART_OutChar(floor);
-  UART_OutChar(END_COMMAND);
+  char command[3] = {elevator, status, floor};
+  SendFrame(command, 3);
 }
 
 void StopElevator(char elevator)
 {
-  UART_OutChar(elevator);
-  UART_OutChar(STOP);
-  UART_OutChar(END_COMMAND);
+  char command[2] = {elevator, STOP};
+  SendFrame(command, 2);
 }
 
 void MovElevator(char elevator, char direction)
 {   
-  UART_OutChar(elevator);
-  UART_OutChar(direction);
-  UART_OutChar(END_COMMAND);
+  char command[2] = {elevator, direction};
+  SendFrame(command, 2);
 }
 
 void SetMovement(char elevator, char actualFloor, char targetFloor)
@@ -227,48 +946,1464 @@ void SetMovement(char elevator, char actualFloor, char targetFloor)
   }
 }
 
-/*----------------------------------------------------------------------------
- *      Aux Functions
- *---------------------------------------------------------------------------*/
-void SetupUart()
+// The car acks door commands in the order they were sent, so each ack is
+// matched against the oldest command still waiting for one
+void DoorSent(DoorObj *door, char status)
 {
-  // Enable the UART0 connection
-  UART_Init();
-
+  if (door->Count == DOOR_COMMANDS)
+  {
+    door->Closed >>= 1;
+    door->Count--;
+  }
+  if (status == CLOSED)
+  {
+    door->Closed |= (uint8_t)(1U << door->Count);
+  }
+  door->Count++;
+}
+
+// An 'A' answers the oldest command, an 'F' the oldest CLOSED along with
+// any OPEN sent before it that was never acked. True when the command
+// answered was a CLOSED, for an 'A' that is a failed close
+bool DoorAcked(DoorObj *door, char ack)
+{
+  bool closed;
+
+  do
+  {
+    if (!door->Count)
+    {
+      return false;
+    }
+    closed = door->Closed & 1U;
+    door->Closed >>= 1;
+    door->Count--;
+  } while (ack == CLOSED_ACK && !closed);
+
+  return closed;
+}
+
+bool DoorClosing(DoorObj *door)
+{
+  return door->Closed != 0;
+}
+
+// After a reset the acks still owed by the car are unknown
+void ResetDoors()
+{
+  bool masked = IntMasterDisable();
+  DoorObj none = {0, 0};
+
+  doorCentral = none;
+  doorPipeline = none;
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Evacuation Functions
+ *---------------------------------------------------------------------------*/
+
+// Switch to the mode of the last fire panel frame. The frame reaches both
+// queues, so a copy coming late finds the mode already applied
+void ApplyMode(ElevatorObj *elevator)
+{
+  char mode = modeRequest;
+  char previous = elevator->TargetFloor;
+  int floor;
+
+  if (mode == 0 || mode == elevator->Mode)
+  {
+    return;
+  }
+
+  if (mode == EVACUATION_MODE)
+  {
+    // Every floor above the exit counts as occupied, car calls are dropped
+    for (floor = 0; floor < FLOORS; floor++)
+    {
+      if (elevator->Stops & (1U << floor))
+      {
+        ChangeButtonStatus(elevator->Elevator, FLOOR_0 + floor, OFF);
+      }
+    }
+    elevator->Mode = EVACUATION_MODE;
+    elevator->Stops = (uint16_t)~FLOOR_BIT(EXIT_FLOOR);
+    LOG_INFO(LOG_EVACUATION, FLOORS - 1, EvacuationTime(elevator->Stops, elevator->ActualFloor) / 1000);
+
+    elevator->TargetFloor = EvacuationStop(elevator);
+    if (elevator->Status == READY)
+    {
+      elevator->Status = BUSY;
+      CloseAndMove(elevator);
+    }
+    else if (elevator->TargetFloor != previous)
+    {
+      TurnMove(elevator);
+    }
+  }
+  else
+  {
+    // Back to normal service, the current trip ends where it was going
+    elevator->Mode = mode;
+    elevator->Stops = 0;
+  }
+
+  // The stops changed wholesale, so do the floors a press must not repeat
+  RebuildCalls(elevator);
+}
+
+// Shuttle between the exit and the highest occupied floor: from the exit go
+// up to the highest one, from anywhere else go down to the exit
+char EvacuationStop(ElevatorObj *elevator)
+{
+  int floor;
+
+  if (elevator->ActualFloor == EXIT_FLOOR)
+  {
+    for (floor = FLOORS - 1; floor >= 0; floor--)
+    {
+      if (elevator->Stops & (1U << floor))
+        return FLOOR_0 + floor;
+    }
+  }
+  return EXIT_FLOOR;
+}
+
+// Estimated time to clear the occupied floors with one car, one round trip
+// from the exit per floor, highest first
+uint32_t EvacuationTime(uint16_t occupied, char fromFloor)
+{
+  uint32_t time = 0;
+  char position = fromFloor;
+  int floor;
+
+  for (floor = FLOORS - 1; floor >= 0; floor--)
+  {
+    if (occupied & (1U << floor))
+    {
+      time += EstimateTravel(position, FLOOR_0 + floor) + EstimateStop();
+      time += EstimateTravel(FLOOR_0 + floor, EXIT_FLOOR) + EstimateStop();
+      position = EXIT_FLOOR;
+    }
+  }
+
+  return time;
+}
+
+/*----------------------------------------------------------------------------
+ *      Health Functions
+ *---------------------------------------------------------------------------*/
+
+// A busy car must send a floor report or an ack within HEALTH_TIMEOUT, timed
+// from when it became busy. When it does not, take it out of service: stop
+// it and keep probing. The door is only opened on a car standing at a floor,
+// one that may have stopped between floors is sent a close instead: both are
+// acked by a car that is only slow, a stopped car sends no floor report.
+// Its calls stay queued and are served once it answers
+void CentralHealth(ElevatorObj *elevator)
+{
+  int index = ELEVATOR_INDEX(elevator->Elevator);
+  uint32_t now = GetTicks();
+  bool masked;
+
+  if (healthHoming[index] && now - homingTime[index] < HomingTimeout())
+  {
+    return;
+  }
+  healthHoming[index] = false;
+  if (elevator->Status != BUSY)
+  {
+    healthWatched[index] = false;
+    return;
+  }
+  if (!healthWatched[index])
+  {
+    healthWatched[index] = true;
+    healthTime[index] = now;
+    return;
+  }
+  if (now - healthTime[index] < HEALTH_TIMEOUT)
+  {
+    return;
+  }
+
+  if (!outOfService[index])
+  {
+    outOfService[index] = true;
+    outageStart[index] = now;
+    outages[index]++;
+    LOG_WARN(LOG_OUT_OF_SERVICE, elevator->Elevator, elevator->ActualFloor);
+
+    // The acks the car still owes may never come
+    ResetDoors();
+  }
+
+  // A late 'F' must not start the car
+  masked = IntMasterDisable();
+  pipelineMove = 0;
+  pipelineReleased = false;
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+
+  // The probe is sent again every HEALTH_TIMEOUT until the car answers
+  StopElevator(elevator->Elevator);
+  ChangeDoorStatus(elevator->Elevator, (elevator->Door == OPEN) ? OPEN : CLOSED);
+  healthTime[index] = now;
+}
+
+// A reset car runs down from wherever it was without a floor report, its
+// acks come as usual. The longest run, from the top floor, plus the usual
+// allowance for silence
+uint32_t HomingTimeout()
+{
+  return (FLOORS - 1) * timing.FloorTime + timing.StartTime + HEALTH_TIMEOUT;
+}
+
+// The car answered again. An ack resumes the trip through the usual rules,
+// the 'A' of a probe closes the door again and a late 'F' sends the move. A
+// floor report shows where a car that was moving is, it is stopped and
+// opened there unless CentralArrival is about to do it
+void CentralRestore(ElevatorObj *elevator, MsgObj *msg)
+{
+  int index = ELEVATOR_INDEX(elevator->Elevator);
+  uint32_t outage = GetTicks() - outageStart[index];
+
+  outOfService[index] = false;
+  outageTime[index] += outage;
+  LOG_INFO(LOG_IN_SERVICE, elevator->Elevator, outage);
+
+  if (msg->Command[1] != OPEN_ACK && msg->Command[1] != CLOSED_ACK
+      && elevator->ActualFloor != elevator->TargetFloor)
+  {
+    StopElevator(elevator->Elevator);
+    ChangeDoorStatus(elevator->Elevator, OPEN);
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Reoptimize Functions
+ *---------------------------------------------------------------------------*/
+
+// The timer only wakes ThreadCentral, the car state stays owned by it. Skip
+// the pass while frames are pending so an idle car does not fill the queue
+void ReoptimizeTimer(void *argument)
+{
+#if USE_RTOS
+  if (osMessageQueueGetCount(qidCentralResponses) == 0)
+  {
+    osMessageQueuePut(qidCentralResponses, &reoptimizeMsg, 0U, 0U);
+  }
+#endif
+}
+
+// Recompute the arrival estimates of all open calls and turn the sweep around
+// when that saves more than REOPTIMIZE_THRESHOLD. The announced target is kept
+// once the car is a floor away from it
+void Reoptimize(ElevatorObj *elevator)
+{
+  char reverse = (elevator->Direction == UP) ? DOWN : UP;
+  char previous = elevator->TargetFloor;
+  uint32_t keep;
+  uint32_t turn;
+
+  if (elevator->Mode != DESTINATION_MODE || elevator->Status != BUSY || elevator->Direction == STOP
+      || outOfService[ELEVATOR_INDEX(elevator->Elevator)])
+  {
+    return;
+  }
+  if (previous - elevator->ActualFloor <= 1 && elevator->ActualFloor - previous <= 1)
+  {
+    return;
+  }
+  PROFILE_BEGIN(probePlan);
+  keep = PlanCost(elevator, elevator->Direction);
+  turn = PlanCost(elevator, reverse);
+  PROFILE_END(probePlan);
+  if (keep <= turn + REOPTIMIZE_THRESHOLD)
+  {
+    return;
+  }
+
+  elevator->Direction = reverse;
+  elevator->TargetFloor = NextStop(elevator);
+  if (elevator->TargetFloor == previous)
+  {
+    return;
+  }
+  reassignCount++;
+  LOG_INFO(LOG_REASSIGN, previous, elevator->TargetFloor);
+
+  TurnMove(elevator);
+}
+
+// Sum of the squared waiting times, in seconds, when the stops are served
+// sweeping first in the given direction and then in the other one
+uint32_t PlanCost(ElevatorObj *elevator, char direction)
+{
+  WaitsObj waits;
+  int count = PlanWaits(elevator, direction, &waits);
+
+  return SumSquares(&waits, count);
+}
+
+// Waiting time of every open call, call age plus estimated arrival, in the
+// order the plan serves them. Both legs scan outward from the car so each
+// stop is counted once, the travel time runs on from the last stop served
+int PlanWaits(ElevatorObj *elevator, char direction, WaitsObj *waits)
+{
+  uint32_t now = GetTicks();
+  uint32_t time = 0;
+  uint32_t wait;
+  int actual = elevator->ActualFloor - FLOOR_0;
+  int position = actual;
+  int step = (direction == UP) ? 1 : -1;
+  int count = 0;
+  int leg;
+  int floor;
+
+  for (leg = 0; leg < 2; leg++)
+  {
+    for (floor = actual + step; floor >= 0 && floor < FLOORS; floor += step)
+    {
+      if (elevator->Stops & (1U << floor))
+      {
+        time += EstimateTravel(FLOOR_0 + position, FLOOR_0 + floor);
+        position = floor;
+        wait = (now - elevator->CallTime[floor] + time) / 1000;
+        waits->Wait[count++] = (uint16_t)((wait > WAIT_LIMIT) ? WAIT_LIMIT : wait);
+        time += EstimateStop();
+      }
+    }
+    step = -step;
+  }
+
+  assert(count <= FLOORS);
+  return count;
+}
+
+// The plain loop: at most FLOORS waits per plan, so neither SMLAD nor a host
+// SIMD path scores a pass measurably faster than this
+uint32_t SumSquares(WaitsObj *waits, int count)
+{
+  uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    sum += (uint32_t)waits->Wait[i] * waits->Wait[i];
+  }
+
+  return sum;
+}
+
+/*----------------------------------------------------------------------------
+ *      Timing Functions
+ *---------------------------------------------------------------------------*/
+
+// Floor reports: the gap between two reports of a run gives the time per
+// floor, the gap from the 'F' ack to the first report the start overhead
+void LearnFloor(char floor, uint32_t time)
+{
+  int floors;
+
+  if (timingFloorTime)
+  {
+    floors = (floor > timingFloor) ? floor - timingFloor : timingFloor - floor;
+    if (floors > 0)
+    {
+      LearnAverage(&timing.FloorTime, (time - timingFloorTime) / floors);
+    }
+  }
+  else if (timingRunTime && time - timingRunTime > timing.FloorTime)
+  {
+    LearnAverage(&timing.StartTime, time - timingRunTime - timing.FloorTime);
+  }
+
+  timingFloorTime = time;
+  timingFloor = floor;
+}
+
+void LearnDoor(char door, uint32_t time)
+{
+  if (door == CLOSED_ACK)
+  {
+    LearnAverage(&timing.CloseTime, time - timingDoorTime);
+    timingRunTime = time;
+    timingFloorTime = 0;
+  }
+  else
+  {
+    LearnAverage(&timing.OpenTime, time - timingDoorTime);
+    timingRunTime = 0;
+    timingFloorTime = 0;
+  }
+}
+
+// Running average over about 8 samples, ignoring anything far off the current
+// value such as a door held open or a frame lost on the link. The model is
+// saved once the sample is in, so the EEPROM never lags a whole save period
+void LearnAverage(uint32_t *average, uint32_t sample)
+{
+  if (sample > 4 * *average || 4 * sample < *average)
+  {
+    return;
+  }
+
+  *average += (uint32_t)(((int32_t)sample - (int32_t)*average) / 8);
+  timing.Samples++;
+  if (eepromReady && timing.Samples % TIMING_SAVE_SAMPLES == 0)
+  {
+    SaveTiming();
+  }
+}
+
+uint32_t EstimateTravel(char fromFloor, char toFloor)
+{
+  int floors = (toFloor > fromFloor) ? toFloor - fromFloor : fromFloor - toFloor;
+
+  if (floors == 0)
+  {
+    return 0;
+  }
+  return timing.StartTime + (uint32_t)floors * timing.FloorTime;
+}
+
+// Time lost by a stop: opening and closing the door
+uint32_t EstimateStop()
+{
+  return timing.OpenTime + timing.CloseTime;
+}
+
+bool LoadTiming()
+{
+  TimingObj model;
+
+  EEPROMRead((uint32_t *)&model, TIMING_ADDRESS, sizeof(TimingObj));
+  if (model.Check != TimingCheck(&model) || !model.FloorTime || !model.StartTime ||
+      !model.OpenTime || !model.CloseTime)
+  {
+    return false;
+  }
+
+  timing = model;
+  return true;
+}
+
+void SaveTiming()
+{
+  LOG_DEBUG(LOG_TIMING_SAVED, timing.FloorTime, timing.Samples);
+  timing.Check = TimingCheck(&timing);
+  EEPROMProgram((uint32_t *)&timing, TIMING_ADDRESS, sizeof(TimingObj));
+}
+
+uint32_t TimingCheck(TimingObj *model)
+{
+  return (model->FloorTime ^ model->StartTime ^ model->OpenTime ^
+          model->CloseTime ^ model->Samples) + 0x5A5A5A5AU;
+}
+
+/*----------------------------------------------------------------------------
+ *      Ingress Functions
+ *---------------------------------------------------------------------------*/
+
+// Runs in the receive path: a button frame for a floor that already has a
+// call queued for that car, or for no floor at all, is dropped before it
+// reaches the queues
+bool AcceptCall(MsgObj *msg)
+{
+  int index = ELEVATOR_INDEX(msg->Command[0]);
+  char floor = GetFloorCharFromCommand(msg);
+  uint16_t bit;
+  bool accepted = true;
+  bool masked;
+
+  // A floor outside the building can never be served, nor its bit cleared
+  if (floor < FLOOR_0 || floor > FLOOR_15)
+  {
+    rejectedCalls++;
+    return false;
+  }
+
+  // Only the central car's calls are served and later cleared, the frames
+  // of the other cars are dropped by ThreadMain and would stay marked
+  if (msg->Command[0] != CENTRAL_ELEVATOR)
+  {
+    return true;
+  }
+  bit = FLOOR_BIT(floor);
+
+  masked = IntMasterDisable();
+  if (pendingCalls[index] & bit)
+  {
+    collapsedCalls[index]++;
+    LOG_DEBUG(LOG_COLLAPSED, msg->Command[0], floor);
+    accepted = false;
+  }
+  else
+  {
+    pendingCalls[index] |= bit;
+  }
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+
+  return accepted;
+}
+
+// The car stopped at the floor, a new press there is a new call
+void ClearCall(char elevator, char floor)
+{
+  bool masked;
+
+  masked = IntMasterDisable();
+  pendingCalls[ELEVATOR_INDEX(elevator)] &= ~FLOOR_BIT(floor);
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+}
+
+// Floors the car is already going to serve, the stops and the current target
+void RebuildCalls(ElevatorObj *elevator)
+{
+  uint16_t calls = elevator->Stops;
+  bool masked;
+
+  if (elevator->Status == BUSY)
+  {
+    calls |= FLOOR_BIT(elevator->TargetFloor);
+  }
+
+  masked = IntMasterDisable();
+  pendingCalls[ELEVATOR_INDEX(elevator->Elevator)] = calls;
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+}
+
+// A call lost on a full queue never reaches the car, a new press must
+void DropCall(MsgObj *msg)
+{
+  char floor = GetFloorCharFromCommand(msg);
+
+  if (msg->Command[0] == CENTRAL_ELEVATOR && IsCommandFrame(msg) && floor >= FLOOR_0 && floor <= FLOOR_15)
+  {
+    ClearCall(msg->Command[0], floor);
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Snapshot Functions
+ *---------------------------------------------------------------------------*/
+
+// Latch with two copies: while the sequence is odd Copy[0] is being written
+// and readers take Copy[1], while it is even they take Copy[0]. The control
+// loop never waits, and a reader in an interrupt always finds a stable copy
+void PublishSnapshot(ElevatorObj *elevator)
+{
+  SnapshotObj snapshot;
+
+  snapshot.Elevator = elevator->Elevator;
+  snapshot.Status = elevator->Status;
+  snapshot.ActualFloor = elevator->ActualFloor;
+  snapshot.TargetFloor = elevator->TargetFloor;
+  snapshot.Direction = elevator->Direction;
+  snapshot.Door = elevator->Door;
+  snapshot.Mode = elevator->Mode;
+  snapshot.Reserved = 0;
+  snapshot.Stops = elevator->Stops;
+
+  centralLatch.Sequence++;
+  __DMB();
+  centralLatch.Copy[0] = snapshot;
+  __DMB();
+  centralLatch.Sequence++;
+  __DMB();
+  centralLatch.Copy[1] = snapshot;
+  __DMB();
+}
+
+// Never blocks; retries only when a publish ran in the middle of the copy
+void ReadSnapshot(SnapshotObj *snapshot)
+{
+  uint32_t sequence;
+
+  while (1)
+  {
+    sequence = centralLatch.Sequence;
+    __DMB();
+    *snapshot = centralLatch.Copy[sequence & 1];
+    __DMB();
+    if (centralLatch.Sequence == sequence)
+    {
+      return;
+    }
+    snapshotRetries++;
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Telemetry Functions
+ *---------------------------------------------------------------------------*/
+
+void TelemetryTimer(void *argument)
+{
+  TelemetryFlush();
+}
+
+// At most one record per TELEMETRY_PERIOD with the latest value of every
+// field changed since the last one: sequence, car id, field flags, then
+// floor index, door, direction and stops (little endian) for the flags set.
+// Every TELEMETRY_ANNOUNCE_PERIODS an announce record (car id '@') carries
+// the controller id and the dropped byte count, so a collector reading many
+// controllers can tell the streams apart and spot losses from the sequence
+void TelemetryFlush()
+{
+  SnapshotObj snapshot;
+  uint8_t record[TELEMETRY_RECORD];
+  uint8_t changed = 0;
+  int size = 1;
+
+  // Nothing is lost while held, the changes go out coalesced after the dump
+  if (telemetryHeld)
+  {
+    return;
+  }
+
+  if (telemetryFlushes++ % TELEMETRY_ANNOUNCE_PERIODS == 0)
+  {
+    record[size++] = TELEMETRY_ANNOUNCE;
+    record[size++] = CONTROLLER_ID;
+    record[size++] = (uint8_t)telemetryDropped;
+    record[size++] = (uint8_t)(telemetryDropped >> 8);
+    TelemetrySend(record, size);
+
+    // Both records would not fit the 16 byte FIFO, the changes wait a period
+    return;
+  }
+
+  // Changes in between two periods are coalesced into the latest state
+  ReadSnapshot(&snapshot);
+  if (snapshot.ActualFloor != telemetrySent.ActualFloor)
+    changed |= TELEMETRY_FLOOR;
+  if (snapshot.Door != telemetrySent.Door)
+    changed |= TELEMETRY_DOOR;
+  if (snapshot.Direction != telemetrySent.Direction)
+    changed |= TELEMETRY_DIRECTION;
+  if (snapshot.Stops != telemetrySent.Stops)
+    changed |= TELEMETRY_STOPS;
+  if (!changed)
+  {
+    return;
+  }
+  telemetrySent = snapshot;
+
+  record[size++] = snapshot.Elevator;
+  record[size++] = changed;
+  if (changed & TELEMETRY_FLOOR)
+    record[size++] = snapshot.ActualFloor - FLOOR_0;
+  if (changed & TELEMETRY_DOOR)
+    record[size++] = snapshot.Door;
+  if (changed & TELEMETRY_DIRECTION)
+    record[size++] = snapshot.Direction;
+  if (changed & TELEMETRY_STOPS)
+  {
+    record[size++] = (uint8_t)snapshot.Stops;
+    record[size++] = (uint8_t)(snapshot.Stops >> 8);
+  }
+
+  TelemetrySend(record, size);
+}
+
+// Bytes that do not fit the UART1 FIFO are dropped rather than waited for,
+// the rest of that frame too
+void TelemetrySend(uint8_t *record, int size)
+{
+  uint8_t frame[TELEMETRY_FRAME + 1];
+  int length = TelemetryEncode(record, size, frame);
+  int i = 0;
+
+  while (i < length && UARTCharPutNonBlocking(UART1_BASE, frame[i]))
+  {
+    i++;
+  }
+  telemetryBytes += i;
+  telemetryDropped += length - i;
+  telemetryResync = (i < length);
+  telemetryRecords++;
+}
+
+// The record gets its sequence and CRC-16 and goes out COBS encoded, ended by
+// TELEMETRY_DELIMITER, so a collector finds the boundaries anywhere in the
+// stream and discards a damaged record by its CRC. The record needs two
+// bytes spare for the CRC, the frame TELEMETRY_FRAME + 1
+int TelemetryEncode(uint8_t *record, int size, uint8_t *frame)
+{
+  uint16_t crc;
+  int length = 0;
+
+  if (telemetryResync)
+  {
+    frame[length++] = TELEMETRY_DELIMITER;
+  }
+  record[0] = telemetrySequence++;
+  crc = Crc16(record, size);
+  record[size++] = (uint8_t)crc;
+  record[size++] = (uint8_t)(crc >> 8);
+  length += CobsEncode(record, size, &frame[length]);
+  frame[length++] = TELEMETRY_DELIMITER;
+
+  return length;
+}
+
+// Consistent overhead byte stuffing: no zero byte in the output, each zero
+// replaced by the distance to the next one. The frame takes size + 1 bytes
+int CobsEncode(const uint8_t *data, int size, uint8_t *frame)
+{
+  int code = 0;
+  int length = 1;
+  int i;
+
+  for (i = 0; i < size; i++)
+  {
+    if (data[i] == 0)
+    {
+      frame[code] = (uint8_t)(length - code);
+      code = length++;
+    }
+    else
+    {
+      frame[length++] = data[i];
+    }
+  }
+  frame[code] = (uint8_t)(length - code);
+
+  return length;
+}
+
+// CRC-16/CCITT-FALSE, polynomial 0x1021 from 0xFFFF, bit by bit: a record is
+// ten bytes at most, a table would cost more flash than it saves
+uint16_t Crc16(const uint8_t *data, int size)
+{
+  uint16_t crc = 0xFFFF;
+  int i;
+  int bit;
+
+  for (i = 0; i < size; i++)
+  {
+    crc ^= (uint16_t)(data[i] << 8);
+    for (bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+/*----------------------------------------------------------------------------
+ *      Pipeline Functions
+ *---------------------------------------------------------------------------*/
+
+// Runs in the receive path for every frame before it is queued
+void PipelineFrame(MsgObj *msg)
+{
+  char move = pipelineMove;
+  bool closeFailed;
+
+  if (msg->Command[0] != CENTRAL_ELEVATOR || msg->Size != 2
+      || (msg->Command[1] != OPEN_ACK && msg->Command[1] != CLOSED_ACK))
+  {
+    return;
+  }
+  closeFailed = DoorAcked(&doorPipeline, msg->Command[1]);
+  if (!move)
+  {
+    return;
+  }
+
+  if (msg->Command[1] == CLOSED_ACK)
+  {
+    pipelineMove = 0;
+    pipelineReleased = true;
+    MovElevator(CENTRAL_ELEVATOR, move);
+    PipelineLatency();
+  }
+  else if (closeFailed)
+  {
+    // Failed close, drop the move and let ThreadCentral close again
+    LOG_WARN(LOG_CLOSE_FAILED, msg->Command[0], move);
+    pipelineMove = 0;
+  }
+}
+
+void PipelineLatency()
+{
+  PROFILE_END(probeCloseToMove);
+}
+
+/*----------------------------------------------------------------------------
+ *      State Functions
+ *---------------------------------------------------------------------------*/
+
+bool SetupEeprom()
+{
+  SysCtlPeripheralEnable(SYSCTL_PERIPH_EEPROM0);
+  while (!SysCtlPeripheralReady(SYSCTL_PERIPH_EEPROM0)){};
+
+  return EEPROMInit() == EEPROM_INIT_OK;
+}
+
+// Pick the valid record with the highest sequence out of all the slots
+bool LoadState()
+{
+  StateObj state;
+  uint32_t slot;
+  bool found = false;
+
+  for (slot = 0; slot < STATE_SLOTS; slot++)
+  {
+    EEPROMRead((uint32_t *)&state, slot * sizeof(StateObj), sizeof(StateObj));
+    if (state.Check == StateCheck(&state) && state.Elevator == CENTRAL_ELEVATOR &&
+        (!found || (int32_t)(state.Sequence - savedState.Sequence) > 0))
+    {
+      savedState = state;
+      stateSlot = slot;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+// Write the record only when it changed, each time in the next slot so the
+// writes are spread over the whole ring
+void SaveState(ElevatorObj *elevator)
+{
+  StateObj state;
+
+  memset(&state, 0, sizeof(StateObj));
+  state.Stops = elevator->Stops;
+  state.Elevator = elevator->Elevator;
+  state.Status = elevator->Status;
+  state.ActualFloor = elevator->ActualFloor;
+  state.TargetFloor = elevator->TargetFloor;
+  state.Door = elevator->Door;
+  state.Mode = elevator->Mode;
+
+  state.Sequence = savedState.Sequence;
+  state.Check = savedState.Check;
+  if (memcmp(&state, &savedState, sizeof(StateObj)) == 0)
+  {
+    return;
+  }
+
+  state.Sequence = savedState.Sequence + 1;
+  state.Check = StateCheck(&state);
+  stateSlot = (stateSlot + 1) % STATE_SLOTS;
+  EEPROMProgram((uint32_t *)&state, stateSlot * sizeof(StateObj), sizeof(StateObj));
+  savedState = state;
+}
+
+// Resume the stored car, closing the door again if it still had a trip to do
+void RestoreState(ElevatorObj *elevator)
+{
+  elevator->Status = savedState.Status;
+  elevator->ActualFloor = savedState.ActualFloor;
+  elevator->TargetFloor = savedState.TargetFloor;
+  elevator->Door = savedState.Door;
+  elevator->Mode = savedState.Mode;
+  elevator->Stops = savedState.Stops;
+
+  if (elevator->Status == BUSY && elevator->TargetFloor != elevator->ActualFloor)
+  {
+    CloseAndMove(elevator);
+  }
+}
+
+// The first floor reported after a warm start must be next to the stored one,
+// otherwise the record was stale and the car is homed as on a cold start:
+// true then, the car is counted at FLOOR_0 and the calls taken so far are
+// dropped, their buttons go dark with the reset and are pressed again
+bool CheckWarmStart(ElevatorObj *elevator, char reportedFloor)
+{
+  warmStart = false;
+
+  if (reportedFloor - elevator->ActualFloor <= 1 && elevator->ActualFloor - reportedFloor <= 1)
+  {
+    return false;
+  }
+  LOG_WARN(LOG_COLD_START, reportedFloor, elevator->ActualFloor);
+  elevator->Status = READY;
+  elevator->ActualFloor = FLOOR_0;
+  elevator->TargetFloor = FLOOR_0;
+  elevator->Direction = STOP;
+  elevator->Door = OPEN;
+  elevator->Stops = 0;
+  pipelineMove = 0;
+  pipelineReleased = false;
+  pendingCalls[ELEVATOR_INDEX(elevator->Elevator)] = 0;
+  InitElevator(elevator->Elevator);
+  return true;
+}
+
+uint16_t StateCheck(StateObj *state)
+{
+  const uint8_t *bytes = (const uint8_t *)state;
+  uint16_t sum = 0x5A5A;
+  uint32_t i;
+
+  for (i = 0; i < sizeof(StateObj); i++)
+  {
+    // Skip the Check field itself
+    if (i != offsetof(StateObj, Check) && i != offsetof(StateObj, Check) + 1)
+    {
+      sum = (uint16_t)((sum << 1) | (sum >> 15)) ^ bytes[i];
+    }
+  }
+
+  return sum;
+}
+
+/*----------------------------------------------------------------------------
+ *      Log Functions
+ *---------------------------------------------------------------------------*/
+
+// Only the token, level, tick and raw arguments are stored, the text is put
+// together later by ThreadLog. A full ring drops the record and counts it
+void LogWrite(uint16_t level, uint16_t token, uint32_t arg0, uint32_t arg1)
+{
+  LogObj *record;
+  bool masked;
+
+  masked = IntMasterDisable();
+  if (logHead - logTail >= LOG_OBJECTS)
+  {
+    logDropped++;
+  }
+  else
+  {
+    record = &logRing[logHead % LOG_OBJECTS];
+    record->Time = GetTicks();
+    record->Token = token;
+    record->Level = level;
+    record->Args[0] = arg0;
+    record->Args[1] = arg1;
+    logHead++;
+  }
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+}
+
+#if USE_RTOS
+void ThreadLog(void *argument)
+{
+  while (1)
+  {
+    PollSpareUart();
+    ReplayStep();
+    LogExpand();
+    osDelay(replay.Active ? 1 : LOG_PERIOD);
+  }
+}
+#endif
+
+// Format the pending records into a line each and send it to the trace
+// port. snprintf only: no stdio stream is opened, so nothing is left for the
+// library to reach through semihosting, which halts a board with no debugger
+void LogExpand()
+{
+  LogObj record;
+  char text[LOG_LINE];
+  uint32_t dropped;
+  int size;
+  bool masked;
+
+  while (logTail != logHead)
+  {
+    record = logRing[logTail % LOG_OBJECTS];
+    logTail++;
+
+    if (record.Token < LOG_TOKENS)
+    {
+      size = snprintf(text, sizeof(text), "%u ", (unsigned)record.Time);
+      size += snprintf(&text[size], sizeof(text) - size, logFormats[record.Token],
+                       record.Args[0], record.Args[1]);
+      LogOutput(text, size);
+    }
+  }
+
+  if (logDropped)
+  {
+    masked = IntMasterDisable();
+    dropped = logDropped;
+    logDropped = 0;
+    if (!masked)
+    {
+      IntMasterEnable();
+    }
+    size = snprintf(text, sizeof(text), "%u log records dropped\n", (unsigned)dropped);
+    LogOutput(text, size);
+  }
+}
+
+// A line cut at LOG_LINE still ends with its newline
+void LogOutput(char *text, int size)
+{
+  int i;
+
+  if (size >= LOG_LINE)
+  {
+    size = LOG_LINE - 1;
+    text[size - 1] = '\n';
+  }
+  for (i = 0; i < size; i++)
+  {
+    stdout_putchar(text[i]);
+  }
+}
+
+// Text output of the firmware: ITM stimulus port 0, read over SWO. Never
+// UART0, the simulator protocol, or UART1, the framed telemetry. Without a
+// debugger the ITM is off and the characters are discarded at once
+int stdout_putchar(int ch)
+{
+  ITM_SendChar((uint32_t)ch);
+  return ch;
+}
+
+#if defined(__ARMCC_VERSION)
+// Any library call that would still trap to a debugger fails the link
+__asm(".global __use_no_semihosting");
+
+// What the library reaches for instead once semihosting is gone
+void _sys_exit(int status)
+{
+  while (1){};
+}
+
+void _ttywrch(int ch)
+{
+  stdout_putchar(ch);
+}
+
+// A failed assert reports to the trace port and stops there
+void __aeabi_assert(const char *expression, const char *file, int line)
+{
+  char text[LOG_LINE];
+
+  IntMasterDisable();
+  LogOutput(text, snprintf(text, sizeof(text), "assert %s:%d %s\n", file, line, expression));
+  while (1){};
+}
+#endif
+
+/*----------------------------------------------------------------------------
+ *      Capture Functions
+ *---------------------------------------------------------------------------*/
+
+// Store a frame with its tick timestamp in the RAM ring, overwriting the oldest
+void CaptureFrame(char direction, const char *command, int size)
+{
+#if CAPTURE_MODE
+  CaptureObj *record;
+  bool masked;
+
+  // Paused while replaying, the replay reads the ring in place
+  if (replay.Active)
+  {
+    return;
+  }
+
+  // Called from both the ISR and the threads, so claim the slot atomically
+  masked = IntMasterDisable();
+  record = &capture[captureCount % CAPTURE_OBJECTS];
+  captureCount++;
+
+  record->Time = GetTicks();
+  record->Direction = direction;
+  record->Size = (char)size;
+  memcpy(record->Command, command, size);
+
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+#endif
+}
+
+// Send the ring over UART1, oldest record first, as telemetry records so one
+// collector reads both: a start record with the count (little endian), then
+// one record per frame with its direction, tick (little endian) and bytes.
+// Telemetry is held meanwhile, and the dump waits for the FIFO instead of
+// dropping, so neither stream lands inside the other
+void DumpCapture()
+{
+  uint8_t record[TELEMETRY_RECORD];
+  uint8_t frame[TELEMETRY_FRAME + 1];
+  uint32_t first = 0;
+  uint32_t count = captureCount;
+  uint32_t i;
+  int size;
+  int length;
+  int j;
+
+  if (count > CAPTURE_OBJECTS)
+  {
+    first = count - CAPTURE_OBJECTS;
+  }
+
+  // The telemetry timer runs above the caller, it sees the flag at once
+  telemetryHeld = true;
+
+  size = 1;
+  record[size++] = TELEMETRY_CAPTURE;
+  record[size++] = CAPTURE_START;
+  record[size++] = (uint8_t)(count - first);
+  record[size++] = (uint8_t)((count - first) >> 8);
+  length = TelemetryEncode(record, size, frame);
+  for (j = 0; j < length; j++)
+  {
+    UARTCharPut(UART1_BASE, frame[j]);
+  }
+  telemetryResync = false; // the start record closed any frame cut short
+
+  for (i = first; i < count; i++)
+  {
+    CaptureObj *entry = &capture[i % CAPTURE_OBJECTS];
+
+    size = 1;
+    record[size++] = TELEMETRY_CAPTURE;
+    record[size++] = entry->Direction;
+    for (j = 0; j < 4; j++)
+    {
+      record[size++] = (uint8_t)(entry->Time >> (8 * j));
+    }
+    memcpy(&record[size], entry->Command, entry->Size);
+    size += entry->Size;
+
+    length = TelemetryEncode(record, size, frame);
+    for (j = 0; j < length; j++)
+    {
+      UARTCharPut(UART1_BASE, frame[j]);
+    }
+  }
+
+  telemetryHeld = false;
+}
+
+// Feed the received frames of the ring back through the receive path, either
+// keeping the original spacing or as fast as the controller takes them.
+// Capture pauses until the replay ends so the ring is not overwritten under
+// it; meant for the bench, with the car idle
+void ReplayCapture(bool realTime)
+{
+  uint32_t first = 0;
+
+  if (replay.Active)
+  {
+    return;
+  }
+  if (captureCount > CAPTURE_OBJECTS)
+  {
+    first = captureCount - CAPTURE_OBJECTS;
+  }
+
+  replay.Next = first;
+  replay.End = captureCount;
+  replay.Start = GetTicks();
+  replay.Base = capture[first % CAPTURE_OBJECTS].Time;
+  replay.RealTime = realTime;
+  replay.Active = (first != captureCount);
+}
+
+// The records due, until a full queue; the rest at the next step. The UART0
+// interrupt is held off around each one, ReceiveFrame is not reentrant and
+// the ring of the event loop has the ISR as its only producer. Only that
+// interrupt, not all of them: RTX calls must not be made with PRIMASK set
+void ReplayStep()
+{
+  CaptureObj *record;
+  MsgObj msg;
+  bool full;
+
+  while (replay.Active && replay.Next != replay.End)
+  {
+    record = &capture[replay.Next % CAPTURE_OBJECTS];
+    if (record->Direction != CAPTURE_RX)
+    {
+      replay.Next++;
+      continue;
+    }
+    if (replay.RealTime && GetTicks() - replay.Start < record->Time - replay.Base)
+    {
+      return;
+    }
+
+    memcpy(msg.Command, record->Command, record->Size);
+    msg.Size = record->Size;
+
+    IntDisable(INT_UART0);
+#if USE_RTOS
+    full = osMessageQueueGetSpace(qidMain) == 0;
+#else
+    full = ringMain.Head - ringMain.Tail >= RING_OBJECTS;
+#endif
+    if (!full)
+    {
+      ReceiveFrame(&msg, 0U);
+    }
+    IntEnable(INT_UART0);
+
+    if (full)
+    {
+      return;
+    }
+    replay.Next++;
+  }
+  replay.Active = false;
+}
+
+// One byte commands on the UART1 receive line, polled by the low priority
+// side: ThreadLog or the idle branch of the event loop
+void PollSpareUart()
+{
+  int32_t ch;
+
+  while ((ch = UARTCharGetNonBlocking(UART1_BASE)) != -1)
+  {
+    if (ch == DUMP_CAPTURE)
+    {
+      DumpCapture();
+    }
+    else if (ch == REPLAY_CAPTURE || ch == REPLAY_FAST)
+    {
+      ReplayCapture(ch == REPLAY_CAPTURE);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------
+ *      Aux Functions
+ *---------------------------------------------------------------------------*/
+void SetupController()
+{
+  IntMasterEnable(); // Enable interruptions
+  SetupUart();       // Set UART configuration
+  SetupSpareUart();  // Set spare UART for telemetry, the capture dump and replay
+
+#if !USE_RTOS
+  // Without RTX the SysTick is free to keep the ms ticks
+  SysTickPeriodSet(SystemCoreClock / 1000);
+  SysTickIntRegister(SysTickHandler);
+  SysTickIntEnable();
+  SysTickEnable();
+#endif
+
+  eepromReady = SetupEeprom();
+  if (eepromReady)
+  {
+    LoadTiming();
+  }
+
+#if WARM_RESTART
+  // Skip re-homing when the car was left stopped at a known floor
+  warmStart = eepromReady && LoadState() &&
+              (savedState.Status == READY || savedState.Door == OPEN);
+#endif
+  if (!warmStart)
+  {
+    InitElevator(CENTRAL_ELEVATOR);
+  }
+}
+
+uint32_t GetTicks()
+{
+#if USE_RTOS
+  return osKernelGetTickCount();
+#else
+  return ticks;
+#endif
+}
+
+bool IsCommandFrame(MsgObj *msg)
+{
+  return msg->Command[1] == INTERNAL_BUTTON || msg->Command[1] == EXTERNAL_BUTTON;
+}
+
+bool IsModeFrame(MsgObj *msg)
+{
+  return msg->Size == 2 && (msg->Command[1] == EVACUATE || msg->Command[1] == NORMAL_OPERATION);
+}
+
+void SetupUart()
+{
+  // Enable the UART0 connection
+  UART_Init();
+
   // Register the handler for the UART0 interruption
   IntRegister(INT_UART0, UARTIntHandler);
 
   // Enable UART0 interruptions for the pin INT_UART0
   IntEnable(INT_UART0);
 
-  // Enable interruptions in the RX and TX for the port UART0_BASE
+  // Interrupt once the receive FIFO holds UART_RX_LEVEL bytes, the receive
+  // timeout (RT) fires for the tail of a frame left below that level
+  UARTFIFOEnable(UART0_BASE);
+  UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX4_8, UART_RX_LEVEL);
   UARTIntEnable(UART0_BASE, UART_INT_RX | UART_INT_RT);
 
   // Clean the Uart Msg
   uartMsg.Size = 0;
 }
 
+void SetupSpareUart()
+{
+  // Enable UART1 on PB0/PB1, used only for diagnostic output
+  SysCtlPeripheralEnable(SYSCTL_PERIPH_UART1);
+  SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
+  while (!SysCtlPeripheralReady(SYSCTL_PERIPH_UART1) || !SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOB)){};
+
+  GPIOPinConfigure(GPIO_PB0_U1RX);
+  GPIOPinConfigure(GPIO_PB1_U1TX);
+  GPIOPinTypeUART(GPIO_PORTB_BASE, GPIO_PIN_0 | GPIO_PIN_1);
+
+  UARTConfigSetExpClk(UART1_BASE, SystemCoreClock, SPARE_BAUD,
+                      UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE);
+  UARTEnable(UART1_BASE);
+}
+
+// Drain the whole receive FIFO on each interrupt. Interrupts per frame is
+// probeUart.Count / countFrames, cycles per byte probeUart.Total / countBytes
 void UARTIntHandler()
 {
-  // Clear the interruption flag for the pin INT_UART0 in the port UART0_BASE
-  UARTIntClear(UART0_BASE, INT_UART0);
+  const int limit = (int)sizeof(uartMsg.Command);
+  uint32_t status;
+  char received;
 
-  // Get the character received in the UART buffer
-  char received = UART_InChar();
+  PROFILE_BEGIN(probeUart);
 
-  if (received != '\n')
+  // Clear the UART0 status bits that raised this interrupt
+  status = UARTIntStatus(UART0_BASE, true);
+  UARTIntClear(UART0_BASE, status);
+  if (status & UART_INT_RT)
   {
+    PROFILE_COUNT(countTimeouts);
+  }
+
+  while (UARTCharsAvail(UART0_BASE))
+  {
+    received = (char)UARTCharGetNonBlocking(UART0_BASE);
+    PROFILE_COUNT(countBytes);
+
+    if (received == '\n')
+    {
+      continue;
+    }
     if (received != '\r')
     {
-      uartMsg.Command[uartMsg.Size] = received;
-      uartMsg.Size++;
+      // A frame longer than a MsgObj is dropped whole at its '\r'
+      if (uartMsg.Size < limit)
+      {
+        uartMsg.Command[uartMsg.Size] = received;
+      }
+      if (uartMsg.Size <= limit)
+      {
+        uartMsg.Size++;
+      }
+    }
+    else if (uartMsg.Size > limit)
+    {
+      uartMsg.Size = 0;
+      PROFILE_COUNT(countOverflows);
     }
     else
     {
-      osMessageQueuePut(qidMain, &uartMsg, 0U, 0U);
+      CaptureFrame(CAPTURE_RX, uartMsg.Command, uartMsg.Size);
+      ReceiveFrame(&uartMsg, 0U);
       uartMsg.Size = 0;
+      PROFILE_COUNT(countFrames);
+    }
+  }
+
+  PROFILE_END(probeUart);
+}
+
+// Hand a complete frame to the controller, shared by the ISR and the replay
+void ReceiveFrame(MsgObj *msg, uint32_t timeout)
+{
+  msg->Time = GetTicks();
+  if (msg->Command[0] >= CENTRAL_ELEVATOR && msg->Command[0] <= LEFT_ELEVATOR
+      && !IsCommandFrame(msg) && !IsModeFrame(msg))
+  {
+    // Floor reports and acks, the buttons say nothing about the car. The
+    // first floor report after a reset ends the homing
+    healthTime[ELEVATOR_INDEX(msg->Command[0])] = msg->Time;
+    if (msg->Command[1] != OPEN_ACK && msg->Command[1] != CLOSED_ACK)
+    {
+      healthHoming[ELEVATOR_INDEX(msg->Command[0])] = false;
     }
   }
+  if (IsCommandFrame(msg) && !AcceptCall(msg))
+  {
+    return;
+  }
+  if (IsModeFrame(msg))
+  {
+    modeRequest = (msg->Command[1] == EVACUATE) ? EVACUATION_MODE : OPERATING_MODE;
+  }
+  PipelineFrame(msg);
+#if USE_RTOS
+  if (osMessageQueuePut(qidMain, msg, 0U, timeout) != osOK)
+#else
+  if (!RingPut(&ringMain, msg))
+#endif
+  {
+    DropCall(msg);
+  }
+}
+
+void SendFrame(const char *command, int size)
+{
+  int i;
+  bool masked;
+
+  // Frames are also sent from the receive path, keep each one whole
+  masked = IntMasterDisable();
+  PROFILE_BEGIN(probeSend);
+
+  for (i = 0; i < size; i++)
+  {
+    UART_OutChar(command[i]);
+  }
+  UART_OutChar(END_COMMAND);
+
+  CaptureFrame(CAPTURE_TX, command, size);
+  PROFILE_END(probeSend);
+
+  if (!masked)
+  {
+    IntMasterEnable();
+  }
+}
+
+// Floor asked by a button frame: "cIa" for the car panel, "cE05s" for a hall
+char GetFloorCharFromCommand(MsgObj *msg)
+{
+	if (msg->Size == 5)
+	{
+		return GetFloorCharFromFloorNumberString(msg->Command[3], msg->Command[2]);
+	}
+	return msg->Command[2];
 }
 
 char GetFloorCharFromFloorNumberString(char floorNumber, char isHigher)
@@ -311,4 +2446,5 @@ char GetFloorCharFromFloorNumberString(char floorNumber, char isHigher)
 		else if(floorNumber == '5')
 			return FLOOR_15;
 	}
+	return 0; // not a floor, outside FLOOR_0..FLOOR_15
 }
\ No newline at end of file
@@ -1,3 +1,25 @@
+/*----------------------------------------------------------------------------
+ *      Simulator Protocol
+ *
+ * ASCII frames ended by END_COMMAND ('\r', a '\n' after it is ignored), each
+ * one starting with the car id: CENTRAL_ELEVATOR, RIGHT_ELEVATOR or
+ * LEFT_ELEVATOR. Floors are FLOOR_0..FLOOR_15 ('a'..'p') when sent and
+ * decimal numbers when received. The car runs from 0 to MAX_HEIGHT mm.
+ *
+ * Sent by the controller:
+ *   <car>r          INIT_ELEVATOR, reset the car to the ground floor
+ *   <car>s|d|p      UP, DOWN or STOP
+ *   <car>a|f        OPEN or CLOSED the door
+ *   <car>L|D<floor> ON or OFF the button light of <floor>
+ *
+ * Sent by the simulator:
+ *   <car>I<floor>   INTERNAL_BUTTON, car panel button, floor as 'a'..'p'
+ *   <car>E<nn><s|d> EXTERNAL_BUTTON, hall button of floor nn going up/down
+ *   <car><n>        floor n (one or two digits) reached while moving
+ *   <car>A|F        OPEN_ACK or CLOSED_ACK, the door finished moving
+ *   <car>X|N        fire panel: EVACUATE, or NORMAL_OPERATION to leave it
+ *---------------------------------------------------------------------------*/
+
 #define MAX_HEIGHT 75000
 
 #define READY 'r'
@@ -11,6 +33,9 @@
 #define RIGHT_ELEVATOR 'd'
 #define LEFT_ELEVATOR 'e'
 
+#define ELEVATORS 3
+#define ELEVATOR_INDEX(elevator) ((elevator) - CENTRAL_ELEVATOR) // 'c'..'e' to 0..2
+
 #define UP 's'
 #define STOP 'p'
 #define DOWN 'd'
@@ -18,9 +43,44 @@
 #define OPEN 'a'
 #define CLOSED 'f'
 
+#define OPEN_ACK 'A'
+#define CLOSED_ACK 'F'
+
 #define ON 'L'
 #define OFF 'D'
 
+#define INTERNAL_BUTTON 'I'
+#define EXTERNAL_BUTTON 'E'
+
+#define REOPTIMIZE '#'                          // internal frame of the re-optimization timer
+
+#define TELEMETRY_FLOOR 0x01                    // telemetry record field flags
+#define TELEMETRY_DOOR 0x02
+#define TELEMETRY_DIRECTION 0x04
+#define TELEMETRY_STOPS 0x08
+
+#define TELEMETRY_DELIMITER 0x00                // ends every COBS encoded telemetry record
+#define TELEMETRY_RECORD 19                     // largest record: sequence, '*', direction, tick, frame, CRC
+#define TELEMETRY_FRAME (TELEMETRY_RECORD + 2)  // COBS overhead byte and delimiter added
+#define TELEMETRY_ANNOUNCE '@'                  // car id of the controller announce record
+#define TELEMETRY_CAPTURE '*'                   // car id of a capture dump record
+#define CAPTURE_START 'S'                       // direction of the record opening a dump
+
+#define NORMAL_MODE 'n'
+#define DESTINATION_MODE 't'
+#define EVACUATION_MODE 'x'
+
+#define EVACUATE 'X'
+#define NORMAL_OPERATION 'N'
+#define EXIT_FLOOR FLOOR_0
+
+#define CAPTURE_RX 'R'
+#define CAPTURE_TX 'T'
+
+#define DUMP_CAPTURE 'C'                        // UART1 diagnostic commands: dump the capture,
+#define REPLAY_CAPTURE 'R'                      // replay it at the original pace
+#define REPLAY_FAST 'F'                         // or as fast as the controller takes it
+
 #define FLOOR_0 'a'
 #define FLOOR_1 'b'
 #define FLOOR_2 'c'
@@ -38,7 +98,97 @@
 #define FLOOR_14 'o'
 #define FLOOR_15 'p'
 
+#define FLOORS 16
+#define FLOOR_BIT(floor) (1U << ((floor) - FLOOR_0))
+
 typedef struct {                                // object data type
   char Command[10];
   int Size;
-} MsgObj;
\ No newline at end of file
+  uint32_t Time;                                // tick the frame was received
+} MsgObj;
+
+typedef struct {                                // elevator state data type
+  char Elevator;
+  char Status;
+  char ActualFloor;
+  char TargetFloor;
+  char Direction;
+  char Door;
+  char Mode;
+  uint16_t Stops;                               // pending stops, one bit per floor
+  uint32_t CallTime[FLOORS];                    // tick each pending stop was called
+} ElevatorObj;
+
+typedef struct {                                // outstanding door commands data type
+  uint8_t Closed;                               // one bit per command, oldest in bit 0, set for CLOSED
+  uint8_t Count;
+} DoorObj;
+
+#define DOOR_COMMANDS 8                         // commands DoorObj remembers
+
+typedef struct {                                // capture record data type
+  uint32_t Time;
+  char Direction;
+  char Size;
+  char Command[10];
+} CaptureObj;
+
+typedef struct {                                // capture replay data type
+  uint32_t Next;                                // capture record fed next
+  uint32_t End;
+  uint32_t Start;                               // tick the replay started at
+  uint32_t Base;                                // tick of the first record replayed
+  bool RealTime;                                // keep the original spacing
+  volatile bool Active;
+} ReplayObj;
+
+typedef struct {                                // persisted state data type
+  uint32_t Sequence;
+  uint16_t Stops;
+  uint16_t Check;
+  char Elevator;
+  char Status;
+  char ActualFloor;
+  char TargetFloor;
+  char Door;
+  char Mode;
+  char Reserved[2];                             // keep the record word sized
+} StateObj;
+
+#define RING_OBJECTS 16
+
+typedef struct {                                // frame ring data type
+  MsgObj Msg[RING_OBJECTS];
+  volatile uint32_t Head;
+  volatile uint32_t Tail;
+} RingObj;
+
+typedef struct {                                // timing model data type
+  uint32_t FloorTime;                           // ms to travel one floor
+  uint32_t StartTime;                           // ms of start and stop overhead per run
+  uint32_t OpenTime;                            // ms from OPEN to the 'A' ack
+  uint32_t CloseTime;                           // ms from CLOSED to the 'F' ack
+  uint32_t Samples;
+  uint32_t Check;
+} TimingObj;
+
+typedef struct {                                // waiting times data type
+  uint16_t Wait[FLOORS];                        // s, in the order the stops are served
+} WaitsObj;
+
+typedef struct {                                // published car state data type
+  char Elevator;
+  char Status;
+  char ActualFloor;
+  char TargetFloor;
+  char Direction;
+  char Door;
+  char Mode;
+  char Reserved;
+  uint16_t Stops;
+} SnapshotObj;
+
+typedef struct {                                // snapshot latch data type
+  volatile uint32_t Sequence;                   // odd while Copy[0] is written
+  SnapshotObj Copy[2];
+} LatchObj;
@@ -0,0 +1,82 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE 1 // 0 removes every probe and counter from the build
+#endif
+
+typedef struct {                                // probe data type
+  uint32_t Start;
+  uint32_t Min;
+  uint32_t Max;
+  uint64_t Total;
+  uint32_t Count;
+} ProbeObj;
+
+#if PROFILE_ENABLE
+
+#if defined(__arm__) || defined(__ARMCC_VERSION)
+// Cortex-M4: DWT cycle counter
+#include "TM4C129.h"
+
+#define PROFILE_INIT() \
+  do { \
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+    DWT->CYCCNT = 0; \
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; \
+  } while (0)
+#define PROFILE_CYCLES() (DWT->CYCCNT)
+#else
+// Host: monotonic clock in nanoseconds
+#include <time.h>
+
+static inline uint32_t ProfileCycles(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec);
+}
+
+#define PROFILE_INIT()
+#define PROFILE_CYCLES() ProfileCycles()
+#endif
+
+static inline void ProfileEnd(ProbeObj *probe)
+{
+  uint32_t cycles = PROFILE_CYCLES() - probe->Start;
+
+  if (cycles < probe->Min)
+    probe->Min = cycles;
+  if (cycles > probe->Max)
+    probe->Max = cycles;
+  probe->Total += cycles;
+  probe->Count++;
+}
+
+#define PROBE(name) ProbeObj name = {0, 0xFFFFFFFFU, 0, 0, 0}
+#define PROFILE_BEGIN(probe) ((probe).Start = PROFILE_CYCLES())
+#define PROFILE_END(probe) ProfileEnd(&(probe))
+#define PROFILE_MEAN(probe) ((probe).Count ? (uint32_t)((probe).Total / (probe).Count) : 0U)
+#define PROFILE_WITHIN(probe, budget) ((probe).Max <= (uint32_t)(budget))
+
+#define COUNTER(name) uint32_t name
+#define PROFILE_COUNT(counter) ((counter)++)
+
+#else
+
+#define PROFILE_INIT()
+#define PROBE(name) extern int profileDisabled
+#define PROFILE_BEGIN(probe) ((void)0)
+#define PROFILE_END(probe) ((void)0)
+#define PROFILE_MEAN(probe) 0U
+#define PROFILE_WITHIN(probe, budget) 1
+
+#define COUNTER(name) extern int profileDisabled
+#define PROFILE_COUNT(counter) ((void)0)
+
+#endif
+
+#endif